@@ -0,0 +1,219 @@
+/*
+ * Copyright (c) 2014 Thomas Daehling <doc@methedrine.org>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "DispatchController.h"
+
+#include <limits>
+
+using namespace QtGoogleAnalytics;
+
+// Limits of the /batch endpoint, see https://developers.google.com/analytics/devguides/collection/protocol/v1/devguide#batch
+const int DispatchController::MaxBatchSize( 20 );
+const int DispatchController::MaxBatchBytes( 16 * 1024 );
+const int DispatchController::MaxHitBytes( 8 * 1024 );
+const int DispatchController::MaxUrlBytes( 2000 );
+const int DispatchController::DefaultTargetQueueDelay( 2000 );
+const int DispatchController::DefaultMaxConcurrency( 8 );
+
+namespace
+{
+    const qreal Smoothing = 0.125;
+    const int FlushIntervalStep = 25;
+    const int CongestionSlack = 50;
+}
+
+DispatchController::DispatchController()
+    : m_adaptive( false ), m_targetQueueDelay( DefaultTargetQueueDelay ), m_maxConcurrency( DefaultMaxConcurrency )
+{
+    reset();
+}
+
+/*!
+ * \brief DispatchController::setAdaptive enables or disables adapting batch size, flush interval and concurrency.
+ *
+ * Changing the mode discards everything that has been learned so far.
+ */
+void DispatchController::setAdaptive( bool enabled )
+{
+    if ( m_adaptive != enabled )
+    {
+        m_adaptive = enabled;
+        reset();
+    }
+}
+
+bool DispatchController::isAdaptive() const
+{
+    return m_adaptive;
+}
+
+/*!
+ * \brief DispatchController::setTargetQueueDelay sets how long a hit may take from being tracked until its request
+ * completes before the controller starts flushing more aggressively.
+ */
+void DispatchController::setTargetQueueDelay( int msecs )
+{
+    if ( msecs > 0 )
+    {
+        m_targetQueueDelay = msecs;
+        m_flushInterval = qMin( m_flushInterval, m_targetQueueDelay );
+    }
+}
+
+int DispatchController::targetQueueDelay() const
+{
+    return m_targetQueueDelay;
+}
+
+void DispatchController::setMaxConcurrency( int requests )
+{
+    if ( requests > 0 )
+    {
+        m_maxConcurrency = requests;
+        m_concurrency = qMin( m_concurrency, m_maxConcurrency );
+    }
+}
+
+int DispatchController::maxConcurrency() const
+{
+    return m_maxConcurrency;
+}
+
+int DispatchController::batchSize() const
+{
+    return m_batchSize;
+}
+
+int DispatchController::flushInterval() const
+{
+    return m_flushInterval;
+}
+
+/*!
+ * \brief DispatchController::concurrency returns how many requests may be in flight at once.
+ *
+ * Without adaptive dispatch this is not limited at all.
+ */
+int DispatchController::concurrency() const
+{
+    return m_adaptive ? m_concurrency : std::numeric_limits<int>::max();
+}
+
+qreal DispatchController::smoothedRoundTripTime() const
+{
+    return m_smoothedRoundTripTime;
+}
+
+qreal DispatchController::errorRate() const
+{
+    return m_errorRate;
+}
+
+/*!
+ * \brief DispatchController::throughput returns the smoothed number of hits completed per second.
+ */
+qreal DispatchController::throughput() const
+{
+    return m_throughput;
+}
+
+/*!
+ * \brief DispatchController::onCompleted feeds the outcome of a finished request back into the controller.
+ *
+ * \param now the time of completion in milliseconds, on the same clock for all calls
+ * \param roundTripTime the time between sending the request and receiving its reply in milliseconds
+ * \param queueDelay the time the oldest hit of the request spent waiting before it was sent in milliseconds
+ * \param hits the number of hits in the request
+ * \param bytes the size of the payload in bytes
+ * \param failed whether the request finished with an error
+ */
+void DispatchController::onCompleted( qint64 now, int roundTripTime, int queueDelay, int hits, int bytes, bool failed )
+{
+    if ( m_minRoundTripTime < 0 )
+    {
+        m_smoothedRoundTripTime = roundTripTime;
+        m_minRoundTripTime = roundTripTime;
+    }
+    else
+    {
+        m_smoothedRoundTripTime += Smoothing * ( roundTripTime - m_smoothedRoundTripTime );
+        m_minRoundTripTime = qMin( m_minRoundTripTime, roundTripTime );
+    }
+    m_errorRate += Smoothing * ( ( failed ? 1.0 : 0.0 ) - m_errorRate );
+    if ( hits > 0 )
+    {
+        m_averageHitBytes += Smoothing * ( qreal( bytes ) / hits - m_averageHitBytes );
+    }
+    if ( m_lastCompletion >= 0 && now > m_lastCompletion )
+    {
+        m_throughput += Smoothing * ( hits * 1000.0 / ( now - m_lastCompletion ) - m_throughput );
+    }
+    m_lastCompletion = now;
+
+    if ( ! m_adaptive )
+    {
+        return;
+    }
+
+    const bool congested = failed || roundTripTime > 2 * m_minRoundTripTime + CongestionSlack;
+    if ( congested )
+    {
+        m_batchSize = qMax( 1, m_batchSize / 2 );
+        m_concurrency = qMax( 1, m_concurrency / 2 );
+        m_concurrencyCredit = 0;
+    }
+    else
+    {
+        const int byteLimit = m_averageHitBytes > 0 ? int( MaxBatchBytes / m_averageHitBytes ) : MaxBatchSize;
+        m_batchSize = qBound( 1, m_batchSize + 1, qMin( MaxBatchSize, byteLimit ) );
+
+        // one additional request per full window of successful requests, like TCP congestion avoidance
+        m_concurrencyCredit += 1.0 / m_concurrency;
+        if ( m_concurrencyCredit >= 1.0 )
+        {
+            m_concurrencyCredit = 0;
+            m_concurrency = qMin( m_concurrency + 1, m_maxConcurrency );
+        }
+    }
+
+    if ( queueDelay + roundTripTime > m_targetQueueDelay )
+    {
+        m_flushInterval /= 2;
+    }
+    else
+    {
+        const int budget = qMax( 0, m_targetQueueDelay - int( m_smoothedRoundTripTime ) );
+        m_flushInterval = qMin( m_flushInterval + FlushIntervalStep, budget );
+    }
+}
+
+void DispatchController::reset()
+{
+    m_batchSize = 1;
+    m_flushInterval = 0;
+    m_concurrency = 1;
+    m_concurrencyCredit = 0;
+    m_smoothedRoundTripTime = 0;
+    m_minRoundTripTime = -1;
+    m_errorRate = 0;
+    m_averageHitBytes = 0;
+    m_throughput = 0;
+    m_lastCompletion = -1;
+}
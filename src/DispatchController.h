@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2014 Thomas Daehling <doc@methedrine.org>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef DISPATCHCONTROLLER_H
+#define DISPATCHCONTROLLER_H
+
+#include "QtGoogleAnalytics_global.h"
+
+#include <QtGlobal>
+
+namespace QtGoogleAnalytics
+{
+
+/*!
+ * \brief The DispatchController decides how many hits go into a request, how long hits may wait for a batch to fill
+ * up, and how many requests may be in flight at once.
+ *
+ * When adaptive dispatch is disabled every hit is sent on its own and immediately. When it is enabled the controller
+ * follows an AIMD scheme: every completed request without congestion grows the batch size and the concurrency
+ * additively, while errors or a round-trip time well above the fastest one observed halve them. The flush interval
+ * is grown as long as the observed queue delay stays below the target and halved as soon as it exceeds it.
+ */
+class QT_GA_EXPORTS DispatchController
+{
+public:
+    static const int MaxBatchSize;
+    static const int MaxBatchBytes;
+    static const int MaxHitBytes;
+    static const int MaxUrlBytes;
+    static const int DefaultTargetQueueDelay;
+    static const int DefaultMaxConcurrency;
+
+    DispatchController();
+
+    void setAdaptive( bool enabled );
+    bool isAdaptive() const;
+
+    void setTargetQueueDelay( int msecs );
+    int targetQueueDelay() const;
+
+    void setMaxConcurrency( int requests );
+    int maxConcurrency() const;
+
+    int batchSize() const;
+    int flushInterval() const;
+    int concurrency() const;
+
+    qreal smoothedRoundTripTime() const;
+    qreal errorRate() const;
+    qreal throughput() const;
+
+    void onCompleted( qint64 now, int roundTripTime, int queueDelay, int hits, int bytes, bool failed );
+    void reset();
+
+private:
+    bool m_adaptive;
+    int m_targetQueueDelay;
+    int m_maxConcurrency;
+
+    int m_batchSize;
+    int m_flushInterval;
+    int m_concurrency;
+    qreal m_concurrencyCredit;
+
+    qreal m_smoothedRoundTripTime;
+    int m_minRoundTripTime;
+    qreal m_errorRate;
+    qreal m_averageHitBytes;
+    qreal m_throughput;
+    qint64 m_lastCompletion;
+};
+
+}
+
+#endif // DISPATCHCONTROLLER_H
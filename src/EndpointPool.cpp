@@ -0,0 +1,263 @@
+/*
+ * Copyright (c) 2014 Thomas Daehling <doc@methedrine.org>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "EndpointPool.h"
+
+using namespace QtGoogleAnalytics;
+
+const int EndpointPool::DefaultFailureThreshold( 3 );
+const int EndpointPool::DefaultCooldown( 5000 );
+const int EndpointPool::MaxCooldown( 5 * 60 * 1000 );
+
+namespace
+{
+    const qreal Smoothing = 0.2;
+    const qreal MinHealth = 0.5;
+}
+
+EndpointPool::EndpointPool( const QUrl& endpoint )
+    : m_failureThreshold( DefaultFailureThreshold ), m_cooldown( DefaultCooldown )
+{
+    setEndpoints( QList<QUrl>() << endpoint );
+}
+
+/*!
+ * \brief EndpointPool::setEndpoints sets the endpoints to send to, in order of preference.
+ *
+ * Invalid URLs are skipped. If none of the URLs is valid the previous endpoints are kept. All health information is
+ * discarded.
+ */
+void EndpointPool::setEndpoints( const QList<QUrl>& endpoints )
+{
+    QList<Endpoint> valid;
+    Q_FOREACH( const QUrl& url, endpoints )
+    {
+        if ( url.isValid() )
+        {
+            Endpoint endpoint;
+            endpoint.url = url;
+            endpoint.health = 1.0;
+            endpoint.consecutiveFailures = 0;
+            endpoint.cooldown = m_cooldown;
+            endpoint.openedAt = 0;
+            endpoint.open = false;
+            endpoint.probing = false;
+            valid << endpoint;
+        }
+    }
+
+    if ( ! valid.isEmpty() )
+    {
+        m_endpoints = valid;
+    }
+}
+
+QList<QUrl> EndpointPool::endpoints() const
+{
+    QList<QUrl> urls;
+    Q_FOREACH( const Endpoint& endpoint, m_endpoints )
+    {
+        urls << endpoint.url;
+    }
+    return urls;
+}
+
+int EndpointPool::size() const
+{
+    return m_endpoints.size();
+}
+
+QUrl EndpointPool::url( int index ) const
+{
+    return m_endpoints.value( index ).url;
+}
+
+/*!
+ * \brief EndpointPool::setFailureThreshold sets the number of consecutive failures after which an endpoint is no
+ * longer used.
+ */
+void EndpointPool::setFailureThreshold( int failures )
+{
+    if ( failures > 0 )
+    {
+        m_failureThreshold = failures;
+    }
+}
+
+int EndpointPool::failureThreshold() const
+{
+    return m_failureThreshold;
+}
+
+/*!
+ * \brief EndpointPool::setCooldown sets how long a failing endpoint is left alone before it is probed again.
+ */
+void EndpointPool::setCooldown( int msecs )
+{
+    if ( msecs > 0 )
+    {
+        m_cooldown = msecs;
+    }
+}
+
+int EndpointPool::cooldown() const
+{
+    return m_cooldown;
+}
+
+/*!
+ * \brief EndpointPool::select returns the index of the endpoint the next request should go to.
+ *
+ * The first endpoint with a closed breaker is preferred, unless an endpoint before it is ready to be probed, in which
+ * case the probe is sent there. The endpoint \a avoid, e.g. the one a retried request just failed at, is only chosen
+ * if no other endpoint is available.
+ *
+ * \returns -1 if every breaker is open, in which case hits should be held back until nextProbe().
+ */
+int EndpointPool::select( qint64 now, int avoid )
+{
+    for ( int i = 0; i < m_endpoints.size(); ++i )
+    {
+        if ( i != avoid && isAvailable( i, now ) )
+        {
+            return i;
+        }
+    }
+    return avoid >= 0 && avoid < m_endpoints.size() && isAvailable( avoid, now ) ? avoid : -1;
+}
+
+// whether a request may go to an endpoint, which starts the probe of an endpoint that is ready to be probed
+bool EndpointPool::isAvailable( int index, qint64 now )
+{
+    Endpoint& endpoint = m_endpoints[index];
+    if ( ! endpoint.open )
+    {
+        return true;
+    }
+    if ( ! endpoint.probing && now - endpoint.openedAt >= endpoint.cooldown )
+    {
+        endpoint.probing = true;
+        return true;
+    }
+    return false;
+}
+
+void EndpointPool::onSuccess( int index )
+{
+    if ( index < 0 || index >= m_endpoints.size() )
+    {
+        return;
+    }
+
+    Endpoint& endpoint = m_endpoints[index];
+    endpoint.health += Smoothing * ( 1.0 - endpoint.health );
+    endpoint.consecutiveFailures = 0;
+    if ( endpoint.open )
+    {
+        // a successful probe means the endpoint has recovered, so its earlier failures no longer count
+        endpoint.open = false;
+        endpoint.probing = false;
+        endpoint.cooldown = m_cooldown;
+        endpoint.health = 1.0;
+    }
+}
+
+void EndpointPool::onFailure( int index, qint64 now )
+{
+    if ( index < 0 || index >= m_endpoints.size() )
+    {
+        return;
+    }
+
+    Endpoint& endpoint = m_endpoints[index];
+    endpoint.health -= Smoothing * endpoint.health;
+    endpoint.consecutiveFailures++;
+    if ( endpoint.open )
+    {
+        if ( endpoint.probing )
+        {
+            endpoint.probing = false;
+            endpoint.openedAt = now;
+            endpoint.cooldown = qMin( endpoint.cooldown * 2, MaxCooldown );
+        }
+    }
+    else if ( endpoint.consecutiveFailures >= m_failureThreshold || endpoint.health < MinHealth )
+    {
+        // intermittent failures open the breaker as well, otherwise the endpoint would never be probed and recover
+        endpoint.open = true;
+        endpoint.openedAt = now;
+        endpoint.cooldown = m_cooldown;
+    }
+}
+
+/*!
+ * \brief EndpointPool::onAborted records that a request to an endpoint ended without telling anything about it, e.g.
+ * because the network went away.
+ *
+ * If the request was a probe, the endpoint may be probed again right away, its cooldown is left as it is.
+ */
+void EndpointPool::onAborted( int index )
+{
+    if ( index < 0 || index >= m_endpoints.size() )
+    {
+        return;
+    }
+    m_endpoints[index].probing = false;
+}
+
+EndpointPool::State EndpointPool::state( int index, qint64 now ) const
+{
+    const Endpoint& endpoint = m_endpoints.at( index );
+    if ( ! endpoint.open )
+    {
+        return Closed;
+    }
+    return ( endpoint.probing || now - endpoint.openedAt >= endpoint.cooldown ) ? HalfOpen : Open;
+}
+
+/*!
+ * \brief EndpointPool::health returns the smoothed success rate of requests to an endpoint, between 0 and 1.
+ */
+qreal EndpointPool::health( int index ) const
+{
+    return m_endpoints.at( index ).health;
+}
+
+/*!
+ * \brief EndpointPool::nextProbe returns the time at which the next endpoint with an open breaker may be probed.
+ *
+ * \returns -1 if there is no endpoint waiting for a probe.
+ */
+qint64 EndpointPool::nextProbe() const
+{
+    qint64 next = -1;
+    Q_FOREACH( const Endpoint& endpoint, m_endpoints )
+    {
+        if ( endpoint.open && ! endpoint.probing )
+        {
+            const qint64 probe = endpoint.openedAt + endpoint.cooldown;
+            if ( next < 0 || probe < next )
+            {
+                next = probe;
+            }
+        }
+    }
+    return next;
+}
@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2014 Thomas Daehling <doc@methedrine.org>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef ENDPOINTPOOL_H
+#define ENDPOINTPOOL_H
+
+#include "QtGoogleAnalytics_global.h"
+
+#include <QList>
+#include <QUrl>
+
+namespace QtGoogleAnalytics
+{
+
+/*!
+ * \brief The EndpointPool keeps track of the health of a prioritized list of endpoints and picks the one to send to.
+ *
+ * Every endpoint has a circuit breaker. After a number of consecutive failures, or once its health drops below one half,
+ * the breaker opens and the endpoint is not used until a cooldown has passed. Then the breaker is half-open, and a single request is let through as a probe:
+ * if it succeeds the breaker closes again, if it fails the breaker opens again with twice the cooldown.
+ */
+class QT_GA_EXPORTS EndpointPool
+{
+public:
+    enum State
+    {
+        Closed,
+        Open,
+        HalfOpen
+    };
+
+    static const int DefaultFailureThreshold;
+    static const int DefaultCooldown;
+    static const int MaxCooldown;
+
+    explicit EndpointPool( const QUrl& endpoint=QUrl() );
+
+    void setEndpoints( const QList<QUrl>& endpoints );
+    QList<QUrl> endpoints() const;
+    int size() const;
+    QUrl url( int index ) const;
+
+    void setFailureThreshold( int failures );
+    int failureThreshold() const;
+
+    void setCooldown( int msecs );
+    int cooldown() const;
+
+    int select( qint64 now, int avoid=-1 );
+    void onSuccess( int index );
+    void onFailure( int index, qint64 now );
+    void onAborted( int index );
+
+    State state( int index, qint64 now ) const;
+    qreal health( int index ) const;
+    qint64 nextProbe() const;
+
+private:
+    bool isAvailable( int index, qint64 now );
+
+    struct Endpoint
+    {
+        QUrl url;
+        qreal health;
+        int consecutiveFailures;
+        int cooldown;
+        qint64 openedAt;
+        bool open;
+        bool probing;
+    };
+
+    QList<Endpoint> m_endpoints;
+    int m_failureThreshold;
+    int m_cooldown;
+};
+
+}
+
+#endif // ENDPOINTPOOL_H
@@ -0,0 +1,196 @@
+/*
+ * Copyright (c) 2014 Thomas Daehling <doc@methedrine.org>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "HitCapture.h"
+
+#include <cstring>
+
+using namespace QtGoogleAnalytics;
+
+namespace
+{
+    const char Magic[] = { 'Q', 'G', 'A', 'C' };
+    const char FormatVersion = 1;
+    const int MaxVarintBytes = 10;
+
+    int encodeVarint( quint64 value, char* out )
+    {
+        int size = 0;
+        do
+        {
+            char byte = char( value & 0x7f );
+            value >>= 7;
+            out[size++] = value ? char( byte | 0x80 ) : byte;
+        }
+        while ( value );
+        return size;
+    }
+}
+
+CaptureWriter::CaptureWriter()
+    : m_lastTimestamp( -1 )
+{
+}
+
+/*!
+ * \brief CaptureWriter::open creates or truncates \a fileName and writes the capture header.
+ */
+bool CaptureWriter::open( const QString& fileName )
+{
+    close();
+    m_file.setFileName( fileName );
+    if ( ! m_file.open( QIODevice::WriteOnly | QIODevice::Truncate ) )
+    {
+        qWarning( "Cannot open capture file %s: %s", qPrintable( fileName ), qPrintable( m_file.errorString() ) );
+        return false;
+    }
+    m_lastTimestamp = -1;
+    return m_file.write( Magic, sizeof( Magic ) ) == sizeof( Magic ) && m_file.putChar( FormatVersion );
+}
+
+bool CaptureWriter::isOpen() const
+{
+    return m_file.isOpen();
+}
+
+void CaptureWriter::close()
+{
+    if ( m_file.isOpen() )
+    {
+        m_file.close();
+    }
+}
+
+/*!
+ * \brief CaptureWriter::write appends a hit that was tracked at \a timestamp milliseconds.
+ *
+ * Timestamps must not decrease between calls.
+ */
+bool CaptureWriter::write( qint64 timestamp, const QByteArray& payload )
+{
+    if ( ! m_file.isOpen() )
+    {
+        return false;
+    }
+
+    const qint64 delta = m_lastTimestamp < 0 ? 0 : qMax( Q_INT64_C( 0 ), timestamp - m_lastTimestamp );
+    m_lastTimestamp = timestamp;
+
+    char header[2 * MaxVarintBytes];
+    int size = encodeVarint( quint64( delta ), header );
+    size += encodeVarint( quint64( payload.size() ), header + size );
+    return m_file.write( header, size ) == size && m_file.write( payload ) == payload.size();
+}
+
+CaptureReader::CaptureReader()
+    : m_timestamp( 0 ), m_error( false )
+{
+}
+
+bool CaptureReader::open( const QString& fileName )
+{
+    close();
+    m_file.setFileName( fileName );
+    if ( ! m_file.open( QIODevice::ReadOnly ) )
+    {
+        qWarning( "Cannot open capture file %s: %s", qPrintable( fileName ), qPrintable( m_file.errorString() ) );
+        return false;
+    }
+
+    char header[sizeof( Magic ) + 1];
+    if ( m_file.read( header, sizeof( header ) ) != sizeof( header ) ||
+         memcmp( header, Magic, sizeof( Magic ) ) != 0 || header[sizeof( Magic )] != FormatVersion )
+    {
+        qWarning( "%s is not a capture file of a supported version", qPrintable( fileName ) );
+        m_file.close();
+        return false;
+    }
+    m_timestamp = 0;
+    m_error = false;
+    return true;
+}
+
+bool CaptureReader::isOpen() const
+{
+    return m_file.isOpen();
+}
+
+void CaptureReader::close()
+{
+    if ( m_file.isOpen() )
+    {
+        m_file.close();
+    }
+}
+
+/*!
+ * \brief CaptureReader::next reads the next hit of the capture.
+ *
+ * \returns false at the end of the capture or if the file is corrupt, in which case hasError() is set.
+ */
+bool CaptureReader::next( qint64& timestamp, QByteArray& payload )
+{
+    if ( ! m_file.isOpen() || m_error || m_file.atEnd() )
+    {
+        return false;
+    }
+
+    quint64 delta = 0;
+    quint64 size = 0;
+    if ( ! readVarint( delta ) || ! readVarint( size ) || size > quint64( m_file.bytesAvailable() ) )
+    {
+        m_error = true;
+        return false;
+    }
+
+    payload = m_file.read( qint64( size ) );
+    if ( payload.size() != int( size ) )
+    {
+        m_error = true;
+        return false;
+    }
+    m_timestamp += qint64( delta );
+    timestamp = m_timestamp;
+    return true;
+}
+
+bool CaptureReader::hasError() const
+{
+    return m_error;
+}
+
+bool CaptureReader::readVarint( quint64& value )
+{
+    value = 0;
+    for ( int i = 0; i < MaxVarintBytes; ++i )
+    {
+        char byte = 0;
+        if ( ! m_file.getChar( &byte ) )
+        {
+            return false;
+        }
+        value |= quint64( byte & 0x7f ) << ( 7 * i );
+        if ( ! ( byte & 0x80 ) )
+        {
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2014 Thomas Daehling <doc@methedrine.org>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef HITCAPTURE_H
+#define HITCAPTURE_H
+
+#include "QtGoogleAnalytics_global.h"
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+
+namespace QtGoogleAnalytics
+{
+
+/*
+ * Capture files start with the magic "QGAC" and a format version byte, followed by one record per hit:
+ * the milliseconds since the previous hit and the length of the encoded payload as unsigned LEB128 varints,
+ * then the payload itself, i.e. the URL encoded parameters exactly as they are sent.
+ */
+
+/*!
+ * \brief The CaptureWriter appends hits to a capture file.
+ *
+ * \sa Tracker::startCapture(), CaptureReader
+ */
+class QT_GA_EXPORTS CaptureWriter
+{
+public:
+    CaptureWriter();
+
+    bool open( const QString& fileName );
+    bool isOpen() const;
+    void close();
+
+    bool write( qint64 timestamp, const QByteArray& payload );
+
+private:
+    Q_DISABLE_COPY( CaptureWriter )
+
+    QFile m_file;
+    qint64 m_lastTimestamp;
+};
+
+/*!
+ * \brief The CaptureReader reads hits back from a capture file.
+ *
+ * Timestamps are relative to the first hit of the capture.
+ */
+class QT_GA_EXPORTS CaptureReader
+{
+public:
+    CaptureReader();
+
+    bool open( const QString& fileName );
+    bool isOpen() const;
+    void close();
+
+    bool next( qint64& timestamp, QByteArray& payload );
+    bool hasError() const;
+
+private:
+    Q_DISABLE_COPY( CaptureReader )
+
+    bool readVarint( quint64& value );
+
+    QFile m_file;
+    qint64 m_timestamp;
+    bool m_error;
+};
+
+}
+
+#endif // HITCAPTURE_H
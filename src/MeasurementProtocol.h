@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2014 Thomas Daehling <doc@methedrine.org>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef MEASUREMENTPROTOCOL_H
+#define MEASUREMENTPROTOCOL_H
+
+// This header is shared between the library and the SchemaGenerator build tool, so it must not depend on Qt.
+
+#include <stdint.h>
+
+namespace QtGoogleAnalytics
+{
+namespace Schema
+{
+    enum ValueType
+    {
+        Text,
+        Integer,
+        Boolean,
+        Currency
+    };
+
+    // Parameter names use '#' as a placeholder for an index, e.g. "cd#" matches "cd1" up to "cd200".
+    struct Parameter
+    {
+        const char* name;
+        ValueType type;
+        int maxLength;      // in bytes, 0 if unlimited
+        int maxIndex;       // upper bound for every index placeholder, 0 if the name has none
+        uint32_t requiredBit;
+    };
+
+    struct HitType
+    {
+        const char* name;
+        uint32_t required;  // mask of Parameter::requiredBit values that must be present
+    };
+
+    const char IndexPlaceholder = '#';
+    const int MaxIndexCount = 3;
+    const uint32_t HashBasis = 2166136261u;
+
+    // FNV-1a, fed one character of the normalized parameter name at a time
+    inline uint32_t hashStep( uint32_t hash, char c )
+    {
+        return ( hash ^ static_cast<unsigned char>( c ) ) * 16777619u;
+    }
+
+    inline uint32_t hashBucket( uint32_t hash, uint32_t bucketMask )
+    {
+        return hash & bucketMask;
+    }
+
+    // Second level of the hash-and-displace perfect hash: every bucket has its own displacement which is mixed
+    // into the key hash so that all keys of the bucket end up in distinct, otherwise unused slots.
+    inline uint32_t hashSlot( uint32_t hash, uint32_t displacement, uint32_t slotMask )
+    {
+        uint32_t h = hash ^ displacement;
+        h ^= h >> 16;
+        h *= 0x85ebca6bu;
+        h ^= h >> 13;
+        h *= 0xc2b2ae35u;
+        h ^= h >> 16;
+        return h & slotMask;
+    }
+}
+}
+
+#endif // MEASUREMENTPROTOCOL_H
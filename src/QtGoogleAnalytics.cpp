@@ -19,16 +19,16 @@
  * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  */
 #include "QtGoogleAnalytics.h"
+#include "MeasurementProtocolSchema.h"
 
 #include <QtGlobal>
-#include <QHash>
-#include <QListIterator>
 #include <QNetworkReply>
 #include <QNetworkRequest>
 #include <QRegExp>
-#include <QStringList>
 #include <QUrlQuery>
 
+#include <cstring>
+
 using namespace QtGoogleAnalytics;
 
 const QUrl Tracker::NormalEndpoint( "http://www.google-analytics.com/collect" );
@@ -36,206 +36,1077 @@ const QUrl Tracker::SecureEndpoint( "https://ssl.google-analytics.com/collect" )
 const QString Tracker::UserAgent( "QtGoogleAnalyticsTracker/1.0" );
 const QString Tracker::DefaultClientID( "QtGoogleAnalytics" );
 const QString Tracker::ProtocolVersion( "1" );
+const int Tracker::DefaultMaxRetries( 0 );
+const int Tracker::DefaultMaxPendingHits( 1000 );
 
 namespace QtGoogleAnalytics
 {
-    typedef bool (*validationFunc)( const QString& value );
-
     bool isBoolean( const QString& value )
     {
-        return (value == "1" || value == "0");
+        return ( value == QLatin1String( "1" ) || value == QLatin1String( "0" ) );
+    }
+
+    // a signed 64 bit integer in canonical form, i.e. without sign for positive values and without leading zeros
+    bool isInteger( const QString& value )
+    {
+        static const char MaxDigits[] = "9223372036854775807";
+        const int maxDigits = sizeof( MaxDigits ) - 1;
+
+        const bool negative = value.startsWith( QLatin1Char( '-' ) );
+        const int first = negative ? 1 : 0;
+        const int digits = value.size() - first;
+        if ( digits == 0 || digits > maxDigits || ( digits > 1 && value.at( first ) == QLatin1Char( '0' ) ) )
+        {
+            return false;
+        }
+        if ( negative && digits == 1 && value.at( first ) == QLatin1Char( '0' ) )
+        {
+            return false;
+        }
+
+        // compare against the largest magnitude digit by digit, -9223372036854775808 is one more than the maximum
+        int order = 0;
+        for ( int i = 0; i < digits; ++i )
+        {
+            const ushort c = value.at( first + i ).unicode();
+            if ( c < '0' || c > '9' )
+            {
+                return false;
+            }
+            if ( order == 0 && digits == maxDigits )
+            {
+                const char limit = MaxDigits[i] + ( negative && i == maxDigits - 1 ? 1 : 0 );
+                order = ( c < ushort( limit ) ) ? -1 : ( c > ushort( limit ) ? 1 : 0 );
+            }
+        }
+        return order <= 0;
+    }
+
+    // anything that ends in a decimal point followed by two to six digits, e.g. "1000.000001", "-55.00" or "$-55.00"
+    bool isCurrency( const QString& value )
+    {
+        const int point = value.lastIndexOf( QLatin1Char( '.' ) );
+        const int decimals = value.size() - point - 1;
+        if ( point < 0 || decimals < 2 || decimals > 6 )
+        {
+            return false;
+        }
+        for ( int i = point + 1; i < value.size(); ++i )
+        {
+            if ( ! value.at( i ).isDigit() )
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool isOfType( Schema::ValueType type, const QString& value )
+    {
+        switch ( type )
+        {
+            case Schema::Integer:
+                return isInteger( value );
+            case Schema::Boolean:
+                return isBoolean( value );
+            case Schema::Currency:
+                return isCurrency( value );
+            case Schema::Text:
+                break;
+        }
+        return true;
+    }
+
+    bool matchesName( const QString& key, const char* name )
+    {
+        int i = 0;
+        for ( ; *name; ++name )
+        {
+            if ( *name == Schema::IndexPlaceholder )
+            {
+                if ( i == key.size() || ! key.at( i ).isDigit() )
+                {
+                    return false;
+                }
+                while ( i < key.size() && key.at( i ).isDigit() )
+                {
+                    ++i;
+                }
+            }
+            else if ( i == key.size() || key.at( i ) != QLatin1Char( *name ) )
+            {
+                return false;
+            }
+            else
+            {
+                ++i;
+            }
+        }
+        return i == key.size();
+    }
+
+    /*!
+     * \brief findParameter looks up the schema entry for a parameter name like "cd12" or "il1pi2nm".
+     *
+     * The name is normalized and hashed in a single pass, digit runs being replaced by the index placeholder, and then
+     * resolved through the generated perfect hash tables.
+     *
+     * \returns nullptr if the parameter is unknown or one of its indexes is out of range.
+     */
+    const Schema::Parameter* findParameter( const QString& key )
+    {
+        uint32_t hash = Schema::HashBasis;
+        int indexes[Schema::MaxIndexCount] = { 0 };
+        int indexCount = 0;
+        bool inIndex = false;
+
+        for ( int i = 0; i < key.size(); ++i )
+        {
+            const ushort c = key.at( i ).unicode();
+            if ( c >= '0' && c <= '9' )
+            {
+                if ( ! inIndex )
+                {
+                    if ( indexCount == Schema::MaxIndexCount )
+                    {
+                        return nullptr;
+                    }
+                    hash = Schema::hashStep( hash, Schema::IndexPlaceholder );
+                    indexes[indexCount] = 0;
+                    inIndex = true;
+                }
+                indexes[indexCount] = qMin( indexes[indexCount] * 10 + ( c - '0' ), 100000 );
+            }
+            else if ( c >= 'a' && c <= 'z' )
+            {
+                if ( inIndex )
+                {
+                    ++indexCount;
+                    inIndex = false;
+                }
+                hash = Schema::hashStep( hash, static_cast<char>( c ) );
+            }
+            else
+            {
+                return nullptr;
+            }
+        }
+        if ( inIndex )
+        {
+            ++indexCount;
+        }
+
+        uint32_t bucket = Schema::hashBucket( hash, Schema::BucketMask );
+        int slot = Schema::Slots[Schema::hashSlot( hash, Schema::Displacements[bucket], Schema::SlotMask )];
+        if ( slot < 0 || ! matchesName( key, Schema::Parameters[slot].name ) )
+        {
+            return nullptr;
+        }
+
+        const Schema::Parameter* parameter = &Schema::Parameters[slot];
+        for ( int i = 0; i < indexCount; ++i )
+        {
+            if ( indexes[i] < 1 || indexes[i] > parameter->maxIndex )
+            {
+                return nullptr;
+            }
+        }
+        return parameter;
+    }
+
+    const Schema::HitType* findHitType( const QString& value )
+    {
+        for ( int i = 0; i < Schema::HitTypeCount; ++i )
+        {
+            if ( value == QLatin1String( Schema::HitTypes[i].name ) )
+            {
+                return &Schema::HitTypes[i];
+            }
+        }
+        return nullptr;
+    }
+
+    bool isValidHit( const Tracker::ParameterList& parameters )
+    {
+        return isValidHit( parameters, Tracker::DeferredParameterList() );
+    }
+
+    // validates a hit like isValidHit(), and sets deferredRequired to the mask of parameters required by its hit type
+    // that only deferred parameters provide
+    bool checkHit( const Tracker::ParameterList& parameters, const Tracker::DeferredParameterList& deferred,
+                   uint32_t& deferredRequired )
+    {
+        const Schema::HitType* hitType = nullptr;
+        uint32_t present = 0;
+        uint32_t deferredPresent = 0;
+
+        for ( auto iter = deferred.constBegin(); iter != deferred.constEnd(); ++iter )
+        {
+            const Schema::Parameter* parameter = findParameter( iter->first );
+            if ( ! parameter || parameter == &Schema::Parameters[Schema::HitTypeParameter] )
+            {
+                return false;
+            }
+            deferredPresent |= parameter->requiredBit;
+        }
+
+        for ( auto iter = parameters.constBegin(); iter != parameters.constEnd(); ++iter )
+        {
+            const Schema::Parameter* parameter = findParameter( iter->first );
+            if ( ! parameter || ! isOfType( parameter->type, iter->second ) )
+            {
+                return false;
+            }
+            present |= parameter->requiredBit;
+
+            if ( parameter == &Schema::Parameters[Schema::HitTypeParameter] )
+            {
+                hitType = findHitType( iter->second );
+            }
+        }
+
+        if ( ! hitType || ( hitType->required & ( present | deferredPresent ) ) != hitType->required )
+        {
+            return false;
+        }
+        deferredRequired = hitType->required & ~present;
+        return true;
+    }
+
+    /*!
+     * \brief isValidHit checks parameters against the Measurement Protocol schema in MeasurementProtocol.schema.
+     *
+     * A hit is valid if it has a known hit type, every parameter is known to the protocol and of the correct type,
+     * and all parameters required by the hit type are present. Deferred parameters count as present, their values are
+     * only checked once they are resolved, and the hit type itself cannot be deferred. A hit whose required deferred
+     * parameter resolves to no valid value is rejected when it is about to be sent.
+     */
+    bool isValidHit( const Tracker::ParameterList& parameters, const Tracker::DeferredParameterList& deferred )
+    {
+        uint32_t deferredRequired = 0;
+        return checkHit( parameters, deferred, deferredRequired );
+    }
+
+    void appendPercentEncoded( QByteArray& query, uint c )
+    {
+        static const char Hex[] = "0123456789ABCDEF";
+        const bool unreserved = ( c >= 'a' && c <= 'z' ) || ( c >= 'A' && c <= 'Z' ) || ( c >= '0' && c <= '9' ) ||
+                                c == '-' || c == '.' || c == '_' || c == '~';
+        if ( unreserved )
+        {
+            query.append( char( c ) );
+        }
+        else
+        {
+            query.append( '%' );
+            query.append( Hex[( c >> 4 ) & 0xf] );
+            query.append( Hex[c & 0xf] );
+        }
+    }
+
+    // UTF-8 and percent encodes value into query without any temporary strings. If maxBytes is not 0 the value is
+    // truncated to at most that many UTF-8 bytes, without splitting characters.
+    void appendEncoded( QByteArray& query, const QString& value, int maxBytes=0 )
+    {
+        int bytes = 0;
+        for ( int i = 0; i < value.size(); ++i )
+        {
+            uint c = value.at( i ).unicode();
+            if ( QChar::isHighSurrogate( c ) && i + 1 < value.size() && value.at( i + 1 ).isLowSurrogate() )
+            {
+                c = QChar::surrogateToUcs4( ushort( c ), value.at( ++i ).unicode() );
+            }
+
+            bytes += ( c < 0x80 ) ? 1 : ( c < 0x800 ? 2 : ( c < 0x10000 ? 3 : 4 ) );
+            if ( maxBytes > 0 && bytes > maxBytes )
+            {
+                return;
+            }
+
+            if ( c < 0x80 )
+            {
+                appendPercentEncoded( query, c );
+            }
+            else if ( c < 0x800 )
+            {
+                appendPercentEncoded( query, 0xc0 | ( c >> 6 ) );
+                appendPercentEncoded( query, 0x80 | ( c & 0x3f ) );
+            }
+            else if ( c < 0x10000 )
+            {
+                appendPercentEncoded( query, 0xe0 | ( c >> 12 ) );
+                appendPercentEncoded( query, 0x80 | ( ( c >> 6 ) & 0x3f ) );
+                appendPercentEncoded( query, 0x80 | ( c & 0x3f ) );
+            }
+            else
+            {
+                appendPercentEncoded( query, 0xf0 | ( c >> 18 ) );
+                appendPercentEncoded( query, 0x80 | ( ( c >> 12 ) & 0x3f ) );
+                appendPercentEncoded( query, 0x80 | ( ( c >> 6 ) & 0x3f ) );
+                appendPercentEncoded( query, 0x80 | ( c & 0x3f ) );
+            }
+        }
+    }
+
+    // appends a parameter with its value truncated to maxBytes, unless maxBytes is 0. As long as query has enough
+    // capacity reserved this does not allocate.
+    void appendQueryItem( QByteArray& query, const QString& key, const QString& value, int maxBytes )
+    {
+        if ( ! query.isEmpty() )
+        {
+            query.append( '&' );
+        }
+        appendEncoded( query, key );
+        query.append( '=' );
+        appendEncoded( query, value, maxBytes );
+    }
+
+    void appendQueryItem( QByteArray& query, const char* key, const QString& value )
+    {
+        if ( ! query.isEmpty() )
+        {
+            query.append( '&' );
+        }
+        query.append( key );
+        query.append( '=' );
+        appendEncoded( query, value );
+    }
+
+    // appends a parameter whose value was provided late, dropping it if the value is null or of the wrong type, or if
+    // the hit would not fit into a request anymore. Returns whether the parameter was appended.
+    bool appendResolved( QByteArray& query, const QString& key, const QString& value )
+    {
+        if ( value.isNull() )
+        {
+            return false;
+        }
+        const Schema::Parameter* parameter = findParameter( key );
+        if ( ! parameter || ! isOfType( parameter->type, value ) )
+        {
+            qWarning( "Dropping parameter %s, \"%s\" is not a valid value.", qPrintable( key ), qPrintable( value ) );
+            return false;
+        }
+
+        const int size = query.size();
+        appendQueryItem( query, key, value, parameter->maxLength );
+        if ( query.size() > DispatchController::MaxHitBytes )
+        {
+            qWarning( "Dropping parameter %s, the hit would exceed the %d byte payload size limit.", qPrintable( key ), DispatchController::MaxHitBytes );
+            query.resize( size );
+            return false;
+        }
+        return true;
+    }
+
+    // whether an encoded query has an item named key, which must not need percent encoding
+    bool hasQueryItem( const QByteArray& query, const QByteArray& key )
+    {
+        int from = 0;
+        while ( from + key.size() < query.size() )
+        {
+            if ( query.at( from + key.size() ) == '=' && memcmp( query.constData() + from, key.constData(), key.size() ) == 0 )
+            {
+                return true;
+            }
+            from = query.indexOf( '&', from );
+            if ( from < 0 )
+            {
+                return false;
+            }
+            ++from;
+        }
+        return false;
+    }
+
+    const int InitialHitBytes = 512;
+    const int InitialRequestBytes = 2048;
+
+    // the longest cache busting parameter appended to GET requests, "&z=" and up to eight digits
+    const int CacheBustingBytes = 11;
+
+    quint64 reject( const Tracker::Completion& completion )
+    {
+        if ( completion )
+        {
+            TrackResult result = { 0, TrackResult::Rejected, 0, 0 };
+            completion( result );
+        }
+        return 0;
+    }
+}
+
+Tracker::Tracker( QObject *parent )
+    : QObject( parent ), m_nam( new QNetworkAccessManager( this ) ), m_userAgent( UserAgent ),
+      m_endpoints( NormalEndpoint ), m_clientID( DefaultClientID ),
+      m_operation( QNetworkAccessManager::PostOperation ), m_cacheBusting( false ), m_batching( true ),
+      m_maxRetries( DefaultMaxRetries ),
+      m_maxPendingHits( DefaultMaxPendingHits ),
+      m_flushTimer( this ), m_nextHitID( 1 ), m_inFlight( 0 ), m_trace( nullptr ),
+      m_reachability( nullptr ), m_draining( false ), m_closing( false ), m_resolving( false )
+{
+    m_clock.start();
+    m_flushTimer.setSingleShot( true );
+    connect( &m_flushTimer, SIGNAL( timeout() ), this, SLOT( dispatch() ) );
+    connectSignals();
+}
+
+/*!
+ * \brief Tracker::~Tracker aborts all requests in flight and reports every hit that was not sent yet as failed.
+ *
+ * A running capture is stopped first, see stopCapture(). Completions of the failed hits, and providers of captured hits
+ * that were not resolved yet, are called from the destructor, so anything they use must outlive the tracker.
+ */
+Tracker::~Tracker()
+{
+    // completions may still track hits, those are failed as well. The trace recorder may already be gone.
+    m_closing = true;
+    m_trace = nullptr;
+    stopCapture();
+    abortRequests( false );
+
+    const qint64 now = m_clock.elapsed();
+    while ( ! m_queue.isEmpty() )
+    {
+        complete( m_queue.dequeue( m_hits ), TrackResult::Failed, now );
     }
+}
+
+/*!
+ * \brief QtGoogleAnalyticsTracker::setNetworkAccessManager sets the QNetworkAccessManager that should be used by this tracker.
+ *
+ * Since a tracker requires a valid QNetworkAccessManager instance it will by default construct one of its own. However,
+ * for some applications this may not be desirable, and as such the network manager to use can overriden using this method.
+ *
+ * Requests still in flight on the previous manager are aborted and their hits are sent again with the new one.
+ *
+ * \note If a nullptr is passed to this function the previously set QNetworkAccessManager will still be used.
+ *
+ * \sa networkAccessManager()
+ */
+void Tracker::setNetworkAccessManager( QNetworkAccessManager *nam )
+{
+    if ( ! nam || nam == m_nam )
+    {
+        return;
+    }
+
+    abortRequests( true );
+    if ( m_nam && m_nam->parent() == this )
+    {
+        delete m_nam;
+    }
+    m_nam = nam;
+    connectSignals();
+    scheduleDispatch();
+}
+
+QNetworkAccessManager* Tracker::networkAccessManager() const
+{
+    return m_nam;
+}
+
+void Tracker::track( const Tracker::ParameterList& parameters )
+{
+    track( parameters, Completion() );
+}
+
+void Tracker::track( const QUrlQuery& query )
+{
+    track( query, Completion() );
+}
+
+/*!
+ * \brief Tracker::track validates and sends a hit, and reports its outcome to \a completion.
+ *
+ * Text values longer than allowed by the protocol are truncated. The completion is called exactly once: right away if
+ * the hit is rejected by isValidHit() or is too large to be sent, otherwise once it has either been sent successfully
+ * or all retries have failed.
+ *
+ * \returns an ID identifying the hit in its TrackResult, or 0 if the hit was rejected.
+ */
+quint64 Tracker::track( const Tracker::ParameterList& parameters, const Completion& completion )
+{
+    return track( parameters, DeferredParameterList(), completion );
+}
+
+/*!
+ * \brief Tracker::track validates and sends a hit with parameters whose values are only provided when it is sent.
+ *
+ * The providers in \a deferred are called once, right before the hit is encoded for its first request, so that costly
+ * values are never computed for hits that are rejected and reflect the state at the time of sending. A provider that
+ * returns a null QString omits its parameter, a value of the wrong type is dropped with a warning. If that parameter is
+ * required by the hit type the hit is reported as TrackResult::Rejected instead of being sent. Deferred parameters
+ * that the hit already sets are ignored. Providers may track hits themselves, these are sent after the hit that is
+ * being resolved.
+ *
+ * \sa isValidHit(), setParameterProvider()
+ */
+quint64 Tracker::track( const ParameterList& parameters, const DeferredParameterList& deferred,
+                        const Completion& completion )
+{
+    bool valid = false;
+    uint32_t deferredRequired = 0;
+    {
+        TraceScope scope( m_trace, "validate" );
+        valid = checkHit( parameters, deferred, deferredRequired );
+    }
+    if ( ! valid )
+    {
+        return reject( completion );
+    }
+
+    const int index = acquireHit();
+    {
+        TraceScope scope( m_trace, "encode" );
+        QByteArray& payload = m_hits[index].payload;
+        for ( int i = 0; i < parameters.size(); ++i )
+        {
+            // text values are cut to their protocol limits, valid hits only contain known parameters
+            const QString& key = parameters.at( i ).first;
+            appendQueryItem( payload, key, parameters.at( i ).second, findParameter( key )->maxLength );
+        }
+        appendQueryItem( payload, "v", ProtocolVersion );
+        appendQueryItem( payload, "tid", m_trackingID );
+        appendQueryItem( payload, "cid", m_clientID );
+    }
+    if ( m_hits[index].payload.size() > DispatchController::MaxHitBytes )
+    {
+        qWarning( "%d exceeds %d byte payload size limit, the hit is rejected.", m_hits[index].payload.size(), DispatchController::MaxHitBytes );
+        m_hits.release( index );
+        return reject( completion );
+    }
+    m_hits[index].deferred = deferred;
+    m_hits[index].required = deferredRequired;
+    return enqueue( index, completion );
+}
+
+/*!
+ * \brief Tracker::track sends a hit without validating it, and reports its outcome to \a completion.
+ *
+ * \returns an ID identifying the hit in its TrackResult, or 0 if the hit is too large to be sent.
+ */
+quint64 Tracker::track( const QUrlQuery& query, const Completion& completion )
+{
+    const int index = acquireHit();
+    {
+        TraceScope scope( m_trace, "encode" );
+        m_hits[index].payload.append( query.toString( QUrl::FullyEncoded ).toLatin1() );
+    }
+    if ( m_hits[index].payload.size() > DispatchController::MaxHitBytes )
+    {
+        qWarning( "%d exceeds %d byte payload size limit, the hit is rejected.", m_hits[index].payload.size(), DispatchController::MaxHitBytes );
+        m_hits.release( index );
+        return reject( completion );
+    }
+    return enqueue( index, completion );
+}
+
+/*!
+ * \brief Tracker::acquireHit returns a hit slot with an empty payload buffer.
+ */
+int Tracker::acquireHit()
+{
+    const int index = m_hits.acquire();
+    QByteArray& payload = m_hits[index].payload;
+    if ( payload.capacity() == 0 )
+    {
+        // reserving marks the capacity as reserved, so that resizing to zero keeps the buffer
+        payload.reserve( InitialHitBytes );
+    }
+    payload.resize( 0 );
+    m_hits[index].required = 0;
+    return index;
+}
+
+quint64 Tracker::enqueue( int index, const Completion& completion )
+{
+    const quint64 id = m_nextHitID++;
+    {
+        TraceScope scope( m_trace, "enqueue", id );
+        Hit& hit = m_hits[index];
+        hit.id = id;
+        hit.queuedAt = m_clock.elapsed();
+        hit.retries = 0;
+        hit.failedAt = -1;
+        hit.resolved = false;
+        hit.capture = m_capture.isOpen();
+        hit.completion = completion;
+        m_queue.enqueue( m_hits, index );
+    }
+    if ( m_trace )
+    {
+        m_trace->asyncBegin( "hit", id );
+    }
+
+    // the oldest hits give way, e.g. when the network has been unreachable for a long time
+    while ( ! m_resolving && m_queue.size() > m_maxPendingHits )
+    {
+        complete( m_queue.dequeue( m_hits ), TrackResult::Failed, m_clock.elapsed() );
+    }
+
+    scheduleDispatch();
+    return id;
+}
+
+/*!
+ * \brief Tracker::resolve appends the values of deferred parameters and parameter providers to a hit about to be sent.
+ *
+ * Deferred parameters and providers are skipped for parameters the hit already has. If a parameter required by the
+ * hit type gets no valid value the hit is left with a non-zero Hit::required, and must be rejected.
+ */
+void Tracker::resolve( int index )
+{
+    // providers may track hits, which can grow the pool, so the hit is only accessed by index after calling them, and
+    // those hits are neither dispatched nor push this one out of the queue before it is resolved
+    m_resolving = true;
+    TraceScope scope( m_trace, "resolve", m_hits[index].id );
+
+    uint32_t missing = m_hits[index].required;
+    DeferredParameterList deferred;
+    deferred.swap( m_hits[index].deferred );
+    for ( auto iter = deferred.constBegin(); iter != deferred.constEnd(); ++iter )
+    {
+        if ( hasQueryItem( m_hits[index].payload, iter->first.toLatin1() ) )
+        {
+            continue;
+        }
+        const QString value = iter->second ? iter->second() : QString();
+        if ( appendResolved( m_hits[index].payload, iter->first, value ) )
+        {
+            missing &= ~findParameter( iter->first )->requiredBit;
+        }
+    }
+
+    const qint64 now = m_clock.elapsed();
+    for ( int i = 0; i < m_providers.size(); ++i )
+    {
+        Provider& provider = m_providers[i];
+        if ( hasQueryItem( m_hits[index].payload, provider.key ) )
+        {
+            continue;
+        }
+        if ( provider.evaluatedAt < 0 || now - provider.evaluatedAt >= provider.ttl )
+        {
+            provider.value = provider.provider();
+            provider.evaluatedAt = now;
+        }
+        if ( appendResolved( m_hits[index].payload, provider.name, provider.value ) )
+        {
+            missing &= ~findParameter( provider.name )->requiredBit;
+        }
+    }
+    m_resolving = false;
+
+    Hit& hit = m_hits[index];
+    hit.resolved = true;
+    hit.required = missing;
+    if ( missing )
+    {
+        qWarning( "A required parameter of hit %llu has no valid value, the hit is rejected.", hit.id );
+    }
+    else if ( hit.capture && m_capture.isOpen() )
+    {
+        m_capture.write( hit.queuedAt, hit.payload );
+    }
+}
+
+/*!
+ * \brief Tracker::scheduleDispatch sends queued hits right away if a full batch is available, otherwise it makes sure
+ * that they are sent once the flush interval has passed.
+ */
+void Tracker::scheduleDispatch()
+{
+    if ( m_closing || m_resolving || ! isOnline() )
+    {
+        // held back until onOnlineStateChanged(), or picked up by the dispatch that is resolving a hit
+        return;
+    }
+    if ( m_queue.size() >= batchSize() )
+    {
+        dispatch();
+    }
+    else if ( ! m_queue.isEmpty() && ! m_flushTimer.isActive() )
+    {
+        m_flushTimer.start( m_dispatchController.flushInterval() );
+    }
+}
+
+/*!
+ * \brief Tracker::dispatch sends as many queued hits as the DispatchController allows.
+ *
+ * If the circuit breakers of all endpoints are open the hits are held back until the next endpoint may be probed, and
+ * while the network is unreachable they are held back until it comes back.
+ */
+void Tracker::dispatch()
+{
+    m_flushTimer.stop();
+    if ( m_closing || m_resolving || ! isOnline() )
+    {
+        return;
+    }
+    while ( ! m_queue.isEmpty() && m_inFlight < m_dispatchController.concurrency() )
+    {
+        const qint64 now = m_clock.elapsed();
+        const int endpoint = m_endpoints.select( now, m_hits[m_queue.head()].failedAt );
+        if ( endpoint < 0 )
+        {
+            const qint64 probe = m_endpoints.nextProbe();
+            if ( probe >= 0 )
+            {
+                m_flushTimer.start( int( qMax( Q_INT64_C( 0 ), probe - now ) ) );
+            }
+            break;
+        }
+        send( endpoint, qMin( batchSize(), m_queue.size() ) );
+    }
+    if ( m_queue.isEmpty() )
+    {
+        m_draining = false;
+    }
+}
+
+int Tracker::batchSize() const
+{
+    // the batch endpoint only accepts POST requests
+    if ( ! m_batching || m_operation != QNetworkAccessManager::PostOperation )
+    {
+        return 1;
+    }
+    // hits held back while offline are drained in full batches
+    return m_draining ? DispatchController::MaxBatchSize : m_dispatchController.batchSize();
+}
+
+void Tracker::onOnlineStateChanged( bool online )
+{
+    if ( m_trace )
+    {
+        m_trace->instant( online ? "online" : "offline" );
+    }
+    if ( online )
+    {
+        m_draining = ! m_queue.isEmpty();
+        dispatch();
+    }
+}
+
+/*!
+ * \brief Tracker::send sends up to \a maxHits queued hits in one request to \a endpoint.
+ *
+ * A batch ends before the hit that would take it over the size limit of the batch endpoint, and a GET hit whose URL
+ * would be longer than allowed is sent with POST instead. Hits are never larger than a single request allows, see
+ * track(). Hits that are missing a required parameter once they are resolved are rejected instead of being sent.
+ */
+void Tracker::send( int endpoint, int maxHits )
+{
+    TraceScope scope( m_trace, "dispatch", m_hits[m_queue.head()].id );
+
+    const int slot = m_requests.acquire();
+
+    // hits are resolved as they are taken from the queue, so the batch size is known without joining the payloads
+    int bytes = 0;
+    SlotQueue<Hit> batch;
+    SlotQueue<Hit> rejected;
+    while ( batch.size() < maxHits && ! m_queue.isEmpty() )
+    {
+        const int index = m_queue.head();
+        if ( ! m_hits[index].resolved )
+        {
+            resolve( index );
+        }
+        if ( m_hits[index].required )
+        {
+            rejected.enqueue( m_hits, m_queue.dequeue( m_hits ) );
+            continue;
+        }
+        const int size = bytes + ( batch.isEmpty() ? 0 : 1 ) + m_hits[index].payload.size();
+        if ( ! batch.isEmpty() && size > DispatchController::MaxBatchBytes )
+        {
+            break;
+        }
+        bytes = size;
+        batch.enqueue( m_hits, m_queue.dequeue( m_hits ) );
+    }
+
+    if ( batch.isEmpty() )
+    {
+        // every hit taken from the queue was rejected, so the endpoint is not used after all
+        m_endpoints.onAborted( endpoint );
+        m_requests.release( slot );
+    }
+    else
+    {
+        sendRequest( slot, endpoint, batch, bytes );
+    }
+
+    // completions run last, as they may track hits themselves
+    const qint64 now = m_clock.elapsed();
+    while ( ! rejected.isEmpty() )
+    {
+        complete( rejected.dequeue( m_hits ), TrackResult::Rejected, now );
+    }
+}
+
+/*!
+ * \brief Tracker::sendRequest sends the hits of \a batch, \a bytes long when joined, in the request \a slot to
+ * \a endpoint.
+ */
+void Tracker::sendRequest( int slot, int endpoint, const SlotQueue<Hit>& batch, int bytes )
+{
+    Request& request = m_requests[slot];
+    request.endpoint = endpoint;
+    request.hits = batch;
+    const int hits = request.hits.size();
+    const Hit& first = m_hits[request.hits.head()];
+
+    bool post = ( m_operation == QNetworkAccessManager::PostOperation );
+    QUrl url;
+    if ( ! post )
+    {
+        url = m_endpoints.url( endpoint );
+        const int urlBytes = url.toEncoded( QUrl::RemoveQuery ).size() + 1 + first.payload.size() +
+                             ( m_cacheBusting ? CacheBustingBytes : 0 );
+        if ( urlBytes > DispatchController::MaxUrlBytes )
+        {
+            post = true;
+            if ( m_trace )
+            {
+                m_trace->instant( "post fallback", first.id );
+            }
+        }
+    }
+
+    QNetworkReply* reply = nullptr;
+    if ( post )
+    {
+        // the body of a recycled slot may still be referenced by a reply that has not been deleted yet
+        if ( request.body.capacity() == 0 || ! request.body.isDetached() )
+        {
+            request.body = QByteArray();
+            request.body.reserve( InitialRequestBytes );
+        }
+        request.body.resize( 0 );
+
+        for ( int index = request.hits.head(); index >= 0; index = m_hits[index].next )
+        {
+            if ( ! request.body.isEmpty() )
+            {
+                request.body.append( '\n' );
+            }
+            request.body.append( m_hits[index].payload );
+        }
+
+        request.bytes = bytes;
+        reply = m_nam->post( postRequest( endpoint, hits > 1 ), request.body );
+    }
+    else
+    {
+        QNetworkRequest req;
+        req.setHeader( QNetworkRequest::UserAgentHeader, m_userAgent );
+
+        QString query = QString::fromLatin1( first.payload );
+        if ( m_cacheBusting )
+        {
+            query += QString( "&z=%1" ).arg( qrand() % 100000000 );
+        }
+
+        url.setQuery( query );
+        req.setUrl( url );
 
-    bool isInteger( const QString& value )
-    {
-        return ( value == QString::number( value.toLongLong() ) );
+        request.bytes = url.toEncoded( QUrl::RemoveQuery ).size() + 1 + query.size();
+        reply = m_nam->get( req );
     }
 
-    bool isCurrency( const QString& value )
-    {
-        QRegExp currency( ".*-?\\d*\\.\\d{2,6}" );
-        return currency.exactMatch( value );
-    }
+    request.reply = reply;
+    request.sentAt = m_clock.elapsed();
+    m_inFlight++;
+}
 
-    bool isValidHit( const Tracker::ParameterList& parameters )
+/*!
+ * \brief Tracker::postRequest returns the cached POST request for an endpoint, with all headers set.
+ */
+const QNetworkRequest& Tracker::postRequest( int endpoint, bool batch )
+{
+    if ( m_postRequests.isEmpty() )
     {
-        QMap<QString, validationFunc> typeValidations;
-        typeValidations.insert( "aip", isBoolean );
-        typeValidations.insert( "je", isBoolean );
-        typeValidations.insert( "tr", isCurrency );
-        typeValidations.insert( "ts", isCurrency );
-        typeValidations.insert( "tt", isCurrency );
-        typeValidations.insert( "ip", isCurrency );
-        typeValidations.insert( "qt", isInteger );
-        typeValidations.insert( "ev", isInteger );
-        typeValidations.insert( "iq", isInteger );
-        typeValidations.insert( "utt", isInteger );
-        typeValidations.insert( "plt", isInteger );
-        typeValidations.insert( "dns", isInteger );
-        typeValidations.insert( "pdt", isInteger );
-        typeValidations.insert( "rrt", isInteger );
-        typeValidations.insert( "tcp", isInteger );
-        typeValidations.insert( "srt", isInteger );
-        // typeValidations.insert( "cm", intValidator ); needs something better because it can be up to 200...
-
-        QList<QString> validHitTypes;
-        validHitTypes << "pageview" << "appview" << "event" << "transaction";
-        validHitTypes << "item" << "social" << "exception" << "timing";
-
-        QMap<QString, QStringList> requiredPerHitType;
-        requiredPerHitType.insert( "transaction", QStringList() << "ti" );
-        requiredPerHitType.insert( "item", QStringList() << "ti" << "in" );
-        requiredPerHitType.insert( "social", QStringList() << "sn" << "sa" << "st" );
-
-        bool foundHitType = false;
-        bool hasAllRequiredParameters = true;
-        bool allParametersOfCorrectType = true;
-
-        QHash<QString, QString> params;
-        QListIterator<QPair<QString, QString>> iter( parameters );
-        while ( iter.hasNext() )
-        {
-            auto param = iter.next();
-            params.insert( param.first, param.second );
-
-            auto validationIter = typeValidations.find( param.first );
-            if ( validationIter != typeValidations.end() )
-            {
-                allParametersOfCorrectType = allParametersOfCorrectType && validationIter.value()( param.second );
-            }
+        Q_FOREACH( const QUrl& url, m_endpoints.endpoints() )
+        {
+            QNetworkRequest req;
+            req.setHeader( QNetworkRequest::UserAgentHeader, m_userAgent );
+            req.setHeader( QNetworkRequest::ContentTypeHeader, "application/x-www-form-urlencoded" );
+            req.setUrl( url );
+            m_postRequests << req;
+            req.setUrl( url.resolved( QUrl( "batch" ) ) );
+            m_postRequests << req;
         }
+    }
+    return m_postRequests.at( 2 * endpoint + ( batch ? 1 : 0 ) );
+}
 
-        auto hitIter = params.find( "t" );
-        if ( hitIter != params.end() && validHitTypes.contains( hitIter.value() ) )
+int Tracker::findRequest( QNetworkReply* reply ) const
+{
+    // only as many slots as requests have ever been in flight at once, so a scan is cheap
+    for ( int i = 0; i < m_requests.capacity(); ++i )
+    {
+        if ( m_requests[i].reply == reply )
         {
-            foundHitType = true;
-            auto requiredIter = requiredPerHitType.find( hitIter.value() );
-            if ( requiredIter != requiredPerHitType.end() )
-            {
-                QListIterator<QString> iter( requiredIter.value() );
-                while ( iter.hasNext() )
-                {
-                    auto value = iter.next();
-                    hasAllRequiredParameters = hasAllRequiredParameters && params.keys().contains( value );
-                }
-            }
+            return i;
         }
-
-        return foundHitType && hasAllRequiredParameters && allParametersOfCorrectType;
     }
+    return -1;
 }
 
-Tracker::Tracker( QObject *parent )
-    : QObject( parent ), m_nam( new QNetworkAccessManager( this ) ), m_userAgent( UserAgent ),
-      m_endpoint( NormalEndpoint ), m_clientID( DefaultClientID ),
-      m_operation( QNetworkAccessManager::PostOperation ), m_cacheBusting( false )
+void Tracker::connectSignals()
 {
-    connectSignals();
+    connect( m_nam, SIGNAL( finished( QNetworkReply* ) ), this, SLOT( onFinished( QNetworkReply* ) ) );
 }
 
 /*!
- * \brief QtGoogleAnalyticsTracker::setNetworkAccessManager sets the QNetworkAccessManager that should be used by this tracker.
- *
- * Since a tracker requires a valid QNetworkAccessManager instance it will by default construct one of its own. However,
- * for some applications this may not be desirable, and as such the network manager to use can overriden using this method.
- *
- * \note If a nullptr is passed to this function the previously set QNetworkAccessManager will still be used.
- *
- * \sa networkAccessManager()
+ * \brief Tracker::abortRequests stops listening to the current network access manager and aborts all requests in
+ * flight, putting their hits back in front of the queue if \a requeue is set, and failing them otherwise.
  */
-void Tracker::setNetworkAccessManager( QNetworkAccessManager *nam )
+void Tracker::abortRequests( bool requeue )
 {
-    if ( ! nam )
+    // replies are owned by their manager, so they are gone if a foreign manager has been deleted already
+    const bool replies = ! m_nam.isNull();
+    if ( replies )
     {
-        return;
+        disconnect( m_nam, SIGNAL( finished( QNetworkReply* ) ), this, SLOT( onFinished( QNetworkReply* ) ) );
     }
 
-    if ( m_nam && m_nam->parent() == this )
+    SlotQueue<Hit> aborted;
+    for ( int slot = 0; slot < m_requests.capacity(); ++slot )
     {
-        delete m_nam;
+        Request& request = m_requests[slot];
+        if ( ! request.reply )
+        {
+            continue;
+        }
+        QNetworkReply* reply = request.reply;
+        request.reply = nullptr;
+        m_inFlight--;
+        m_endpoints.onAborted( request.endpoint );
+        aborted.prepend( m_hits, request.hits );
+        m_requests.release( slot );
+
+        if ( replies )
+        {
+            reply->abort();
+            reply->deleteLater();
+        }
     }
-    m_nam = nam;
-    connectSignals();
-}
 
-QNetworkAccessManager* Tracker::networkAccessManager() const
-{
-    return m_nam;
+    if ( requeue )
+    {
+        m_queue.prepend( m_hits, aborted );
+        return;
+    }
+    const qint64 now = m_clock.elapsed();
+    while ( ! aborted.isEmpty() )
+    {
+        complete( aborted.dequeue( m_hits ), TrackResult::Failed, now );
+    }
 }
 
-void Tracker::track( const Tracker::ParameterList& parameters )
+void Tracker::onFinished( QNetworkReply *reply )
 {
-    if ( ! isValidHit( parameters ) )
+    const int slot = reply ? findRequest( reply ) : -1;
+    if ( slot < 0 )
     {
         return;
     }
+    Request& request = m_requests[slot];
+    TraceScope scope( m_trace, "reply", m_hits[request.hits.head()].id );
+    request.reply = nullptr;
+    m_inFlight--;
 
-    QUrlQuery query;
-    query.setQueryItems( parameters );
-    query.addQueryItem( QString( "v" ), ProtocolVersion );
-    query.addQueryItem( QString( "tid" ), m_trackingID );
-    query.addQueryItem( QString( "cid" ), m_clientID );
-    track( query );
-}
-
-void Tracker::track( const QUrlQuery& query )
-{
-    QNetworkRequest req;
-    req.setHeader( QNetworkRequest::UserAgentHeader, m_userAgent );
+    const bool failed = ( reply->error() != QNetworkReply::NoError );
+    if ( failed )
+    {
+        qWarning( "Network reply finished with error: %s", qPrintable( reply->errorString() ) );
+    }
+    reply->deleteLater();
 
-    if ( m_operation == QNetworkAccessManager::PostOperation )
+    // requests that fail because the network went away say nothing about the endpoint or the network conditions
+    const bool offline = failed && ! isOnline();
+    const qint64 now = m_clock.elapsed();
+    if ( ! offline )
     {
-        QByteArray data = query.toString( QUrl::FullyEncoded ).toLatin1();
-        if ( data.size() > 8192 )
-        {
-            qWarning( "%d exceeds 8192 byte payload size limit for POST operations.", data.size() );
-        }
-        req.setHeader( QNetworkRequest::ContentTypeHeader, "application/x-www-form-urlencoded" );
-        req.setUrl( m_endpoint );
+        m_dispatchController.onCompleted( now, int( now - request.sentAt ), int( request.sentAt - m_hits[request.hits.head()].queuedAt ),
+                                          request.hits.size(), request.bytes, failed );
+    }
 
-        m_replies.insert( m_nam->post( req, data ) );
+    SlotQueue<Hit> completed;
+    if ( offline )
+    {
+        m_endpoints.onAborted( request.endpoint );
+        m_queue.prepend( m_hits, request.hits );
     }
-    else if ( m_operation == QNetworkAccessManager::GetOperation )
+    else if ( failed )
     {
-        QUrl url = m_endpoint;
-        QUrlQuery q = query;
+        m_endpoints.onFailure( request.endpoint, now );
 
-        if ( m_cacheBusting )
+        // put hits that may be retried back in front of the queue, in their original order
+        SlotQueue<Hit> retries;
+        while ( ! request.hits.isEmpty() )
         {
-            q.addQueryItem( "z", QString::number( qrand() % 100000000 ) );
+            const int index = request.hits.dequeue( m_hits );
+            Hit& hit = m_hits[index];
+            if ( hit.retries < m_maxRetries )
+            {
+                hit.retries++;
+                hit.failedAt = request.endpoint;
+                retries.enqueue( m_hits, index );
+                if ( m_trace )
+                {
+                    m_trace->instant( "retry", hit.id );
+                }
+            }
+            else
+            {
+                completed.enqueue( m_hits, index );
+            }
         }
+        m_queue.prepend( m_hits, retries );
+    }
+    else
+    {
+        m_endpoints.onSuccess( request.endpoint );
+        completed.prepend( m_hits, request.hits );
+    }
 
-        url.setQuery( q );
-        req.setUrl( url );
-
-        int size = url.toString( QUrl::FullyEncoded ).size();
-        if ( size > 2000 )
-        {
-            qWarning( "%d exceeds 2000 byte payload size limit for GET operations.", size );
-        }
+    // the slot is released after dispatching so that its body is not reused while the reply still references it
+    scheduleDispatch();
+    m_requests.release( slot );
 
-        m_replies.insert( m_nam->get( req ) );
+    while ( ! completed.isEmpty() )
+    {
+        complete( completed.dequeue( m_hits ), failed ? TrackResult::Failed : TrackResult::Sent, now );
     }
 }
 
-void Tracker::connectSignals()
+/*!
+ * \brief Tracker::complete reports the final outcome of a hit and recycles its slot.
+ *
+ * \note tracked() is emitted regardless of the outcome, use the completion of track() to tell success from failure.
+ */
+void Tracker::complete( int index, TrackResult::Status status, qint64 now )
 {
-    connect( m_nam, SIGNAL( finished( QNetworkReply* ) ), this, SLOT( onFinished( QNetworkReply* ) ) );
-}
+    Hit& hit = m_hits[index];
+    const TrackResult result = { hit.id, status, hit.retries, now - hit.queuedAt };
+    Completion completion;
+    completion.swap( hit.completion );
+    // hits pushed out of the queue are never resolved, their providers must not outlive them
+    hit.deferred = DeferredParameterList();
+    m_hits.release( index );
 
-void Tracker::onFinished( QNetworkReply *reply )
-{
-    if ( ! m_replies.contains( reply ) )
+    if ( completion )
     {
-        return;
+        completion( result );
     }
-
-    if ( reply->error() != QNetworkReply::NoError )
+    if ( m_trace )
     {
-        qWarning( "Network reply finished with error: %s", qPrintable( reply->errorString() ) );
+        m_trace->asyncEnd( "hit", result.id );
     }
-    reply->deleteLater();
-    m_replies.remove( reply );
     emit tracked();
 }
 
@@ -260,6 +1131,7 @@ void Tracker::setUserAgent( const QString& userAgent )
     if ( ! userAgent.isEmpty() )
     {
         m_userAgent = userAgent;
+        m_postRequests.clear();
     }
 }
 
@@ -268,17 +1140,91 @@ QString Tracker::userAgent() const
     return m_userAgent;
 }
 
+/*!
+ * \brief Tracker::setEndpoint sets the single endpoint hits are sent to.
+ *
+ * Requests with more than one hit go to the URL "batch" resolved against \a endpoint, e.g.
+ * http://www.google-analytics.com/batch for NormalEndpoint or http://proxy/batch for http://proxy/ingest. Disable
+ * batching with setBatching() for collectors that do not accept batches there.
+ *
+ * \sa setEndpoints()
+ */
 void Tracker::setEndpoint( const QUrl& endpoint )
 {
-    if ( endpoint.isValid() )
+    setEndpoints( QList<QUrl>() << endpoint );
+}
+
+/*!
+ * \brief Tracker::endpoint returns the preferred endpoint.
+ *
+ * \sa endpoints()
+ */
+QUrl Tracker::endpoint() const
+{
+    return m_endpoints.url( 0 );
+}
+
+/*!
+ * \brief Tracker::setEndpoints sets the endpoints hits are sent to, in order of preference.
+ *
+ * Hits go to the first endpoint that is healthy. An endpoint that keeps failing is taken out of rotation by a circuit
+ * breaker and probed again after a cooldown; hits are failed over to the next endpoint in the meantime, or held back
+ * if there is none. Batches go to the URL "batch" resolved against each endpoint, see setEndpoint().
+ *
+ * \note Invalid URLs are ignored. If no URL is valid the previous endpoints are kept.
+ *
+ * \sa EndpointPool
+ */
+void Tracker::setEndpoints( const QList<QUrl>& endpoints )
+{
+    m_endpoints.setEndpoints( endpoints );
+    m_postRequests.clear();
+}
+
+QList<QUrl> Tracker::endpoints() const
+{
+    return m_endpoints.endpoints();
+}
+
+const EndpointPool& Tracker::endpointPool() const
+{
+    return m_endpoints;
+}
+
+/*!
+ * \brief Tracker::setEndpointCooldown sets how long an endpoint whose circuit breaker opened is left alone before it
+ * is probed again.
+ *
+ * \sa EndpointPool::setCooldown()
+ */
+void Tracker::setEndpointCooldown( int msecs )
+{
+    m_endpoints.setCooldown( msecs );
+}
+
+int Tracker::endpointCooldown() const
+{
+    return m_endpoints.cooldown();
+}
+
+/*!
+ * \brief Tracker::setMaxRetries sets how often a hit is sent again after its request failed.
+ *
+ * Retries are sent right away, preferably to another endpoint than the one the request failed at, see setEndpoints().
+ * By default hits are not retried, because with a single endpoint the failures would open its breaker and hold the hit
+ * back for the whole cooldown.
+ */
+void Tracker::setMaxRetries( int retries )
+{
+    if ( retries >= 0 )
     {
-        m_endpoint = endpoint;
+        m_maxRetries = retries;
     }
 }
 
-QUrl Tracker::endpoint() const
+int Tracker::maxRetries() const
 {
-    return m_endpoint;
+    return m_maxRetries;
 }
 
 void Tracker::setClientID( const QString& clientID )
@@ -322,3 +1268,227 @@ bool Tracker::cacheBusting() const
 {
     return m_cacheBusting;
 }
+
+/*!
+ * \brief Tracker::setBatching enables or disables sending several hits in one request to the batch URL of an endpoint.
+ *
+ * Batching is enabled by default. It is used by adaptive dispatch and to drain hits held back while offline, and only
+ * with POST requests. Without it every hit is sent on its own.
+ *
+ * \sa setEndpoint()
+ */
+void Tracker::setBatching( bool enabled )
+{
+    m_batching = enabled;
+}
+
+bool Tracker::batching() const
+{
+    return m_batching;
+}
+
+/*!
+ * \brief Tracker::setAdaptiveDispatch enables batching hits and adapting batch size, flush interval and the number of
+ * concurrent requests to the observed network conditions.
+ *
+ * By default every hit is sent on its own as soon as it is tracked.
+ *
+ * \sa DispatchController
+ */
+void Tracker::setAdaptiveDispatch( bool enabled )
+{
+    m_dispatchController.setAdaptive( enabled );
+}
+
+bool Tracker::adaptiveDispatch() const
+{
+    return m_dispatchController.isAdaptive();
+}
+
+void Tracker::setTargetQueueDelay( int msecs )
+{
+    m_dispatchController.setTargetQueueDelay( msecs );
+}
+
+int Tracker::targetQueueDelay() const
+{
+    return m_dispatchController.targetQueueDelay();
+}
+
+const DispatchController& Tracker::dispatchController() const
+{
+    return m_dispatchController;
+}
+
+int Tracker::pendingHits() const
+{
+    return m_queue.size();
+}
+
+/*!
+ * \brief Tracker::setMaxPendingHits limits the number of hits waiting to be sent.
+ *
+ * When a hit is tracked while the limit is reached, the oldest waiting hit is reported as failed. This bounds the
+ * memory used while hits are held back, e.g. while the network is unreachable.
+ */
+void Tracker::setMaxPendingHits( int hits )
+{
+    if ( hits > 0 )
+    {
+        m_maxPendingHits = hits;
+    }
+}
+
+int Tracker::maxPendingHits() const
+{
+    return m_maxPendingHits;
+}
+
+/*!
+ * \brief Tracker::setTraceRecorder records the time spent in each stage of tracking a hit into \a recorder.
+ *
+ * Tracing is disabled by default. Passing nullptr disables it again. The recorder is not owned by the tracker and may
+ * be shared between trackers.
+ */
+void Tracker::setTraceRecorder( TraceRecorder* recorder )
+{
+    m_trace = recorder;
+}
+
+TraceRecorder* Tracker::traceRecorder() const
+{
+    return m_trace;
+}
+
+/*!
+ * \brief Tracker::setReachability pauses sending hits while \a reachability reports the network as offline.
+ *
+ * Hits tracked while offline are held in the queue, as are hits of requests that fail while offline, without using up
+ * their retries, up to maxPendingHits(). Once the network is back the queue is drained in full batches. By default no
+ * reachability is watched and the network is assumed to be online, use NetworkReachability to follow the state
+ * reported by the system. The reachability is not owned by the tracker and may be shared between trackers. Passing
+ * nullptr disables it again, as does destroying the reachability.
+ */
+void Tracker::setReachability( Reachability* reachability )
+{
+    if ( m_reachability )
+    {
+        disconnect( m_reachability, SIGNAL( onlineStateChanged( bool ) ), this, SLOT( onOnlineStateChanged( bool ) ) );
+        disconnect( m_reachability, SIGNAL( destroyed() ), this, SLOT( onReachabilityDestroyed() ) );
+    }
+    m_reachability = reachability;
+    if ( m_reachability )
+    {
+        connect( m_reachability, SIGNAL( onlineStateChanged( bool ) ), this, SLOT( onOnlineStateChanged( bool ) ) );
+        connect( m_reachability, SIGNAL( destroyed() ), this, SLOT( onReachabilityDestroyed() ) );
+    }
+    scheduleDispatch();
+}
+
+void Tracker::onReachabilityDestroyed()
+{
+    // the network is assumed to be online from now on, so hits held back are sent without waiting for the next hit
+    scheduleDispatch();
+}
+
+Reachability* Tracker::reachability() const
+{
+    return m_reachability;
+}
+
+bool Tracker::isOnline() const
+{
+    return ! m_reachability || m_reachability->isOnline();
+}
+
+/*!
+ * \brief Tracker::setParameterProvider adds the parameter \a name to every hit that does not set it itself, with the
+ * value returned by \a provider.
+ *
+ * The provider is called when a hit is about to be sent, and its value is reused for \a ttl milliseconds. With a ttl of
+ * 0 it is called for every hit. Setting a provider for a name that already has one replaces it. Providers may track
+ * hits themselves, but must not set or remove providers.
+ *
+ * \sa removeParameterProvider()
+ */
+void Tracker::setParameterProvider( const QString& name, const ValueProvider& provider, int ttl )
+{
+    if ( ! findParameter( name ) || ! provider )
+    {
+        return;
+    }
+
+    Provider entry;
+    entry.name = name;
+    entry.key = name.toLatin1();
+    entry.provider = provider;
+    entry.ttl = qMax( 0, ttl );
+    entry.evaluatedAt = -1;
+
+    for ( int i = 0; i < m_providers.size(); ++i )
+    {
+        if ( m_providers.at( i ).name == name )
+        {
+            m_providers[i] = entry;
+            return;
+        }
+    }
+    m_providers << entry;
+}
+
+void Tracker::removeParameterProvider( const QString& name )
+{
+    for ( int i = 0; i < m_providers.size(); ++i )
+    {
+        if ( m_providers.at( i ).name == name )
+        {
+            m_providers.removeAt( i );
+            return;
+        }
+    }
+}
+
+/*!
+ * \brief Tracker::startCapture records every hit accepted from now on into the capture file \a fileName.
+ *
+ * Each hit is stored when it is sent for the first time, with the time it was tracked and its encoded parameters
+ * including resolved deferred values, so that the stream can be replayed with its original timing, e.g. by the
+ * ga-replay tool. Hits tracked before the capture started are not stored, even if they are sent during it. Hits that
+ * are failed by maxPendingHits() before they are sent are not stored either, as their parameters are never resolved. A
+ * capture that is already running is stopped first.
+ *
+ * \sa stopCapture(), CaptureReader
+ */
+bool Tracker::startCapture( const QString& fileName )
+{
+    stopCapture();
+    return m_capture.open( fileName );
+}
+
+/*!
+ * \brief Tracker::stopCapture stops recording hits.
+ *
+ * Hits tracked during the capture that have not been sent yet, e.g. because the network is unreachable, are resolved
+ * right away, so that the capture holds every hit accepted while it was running, except those that were failed by
+ * maxPendingHits() in the meantime. The destructor stops a running capture as well.
+ */
+void Tracker::stopCapture()
+{
+    if ( ! m_capture.isOpen() )
+    {
+        return;
+    }
+    for ( int index = m_queue.head(); index >= 0; index = m_hits[index].next )
+    {
+        if ( m_hits[index].capture && ! m_hits[index].resolved )
+        {
+            resolve( index );
+        }
+    }
+    m_capture.close();
+}
+
+bool Tracker::isCapturing() const
+{
+    return m_capture.isOpen();
+}
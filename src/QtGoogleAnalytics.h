@@ -23,38 +23,82 @@
 #define QTGOOGLEANALYTICS_H
 
 #include "QtGoogleAnalytics_global.h"
+#include "DispatchController.h"
+#include "EndpointPool.h"
+#include "HitCapture.h"
+#include "Reachability.h"
+#include "SlotPool.h"
+#include "TraceRecorder.h"
 
+#include <QByteArray>
+#include <QElapsedTimer>
 #include <QList>
 #include <QNetworkAccessManager>
+#include <QNetworkRequest>
 #include <QObject>
-#include <QSet>
+#include <QPointer>
 #include <QString>
+#include <QTimer>
 #include <QUrl>
 
+#include <functional>
+
 class QNetworkReply;
 
 namespace QtGoogleAnalytics
 {
 
+/*!
+ * \brief The TrackResult describes the final outcome of a single hit.
+ */
+struct TrackResult
+{
+    enum Status
+    {
+        Sent,       // the hit was accepted by an endpoint
+        Failed,     // every attempt to send the hit failed
+        Rejected    // the hit was invalid and never sent
+    };
+
+    quint64 id;
+    Status status;
+    int retries;
+    qint64 latency; // milliseconds from tracking the hit until its outcome was known
+};
+
+
 class QT_GA_EXPORTS Tracker : public QObject
 {
     Q_OBJECT
 public:
     typedef QList<QPair<QString, QString> > ParameterList;
+    typedef std::function<void( const TrackResult& )> Completion;
+    typedef std::function<QString()> ValueProvider;
+    typedef QList<QPair<QString, ValueProvider> > DeferredParameterList;
 
     static const QUrl NormalEndpoint;
     static const QUrl SecureEndpoint;
     static const QString UserAgent;
     static const QString DefaultClientID;
     static const QString ProtocolVersion;
+    static const int DefaultMaxRetries;
+    static const int DefaultMaxPendingHits;
 
     explicit Tracker( QObject* parent=nullptr );
+    ~Tracker();
 
     void setNetworkAccessManager( QNetworkAccessManager* nam );
     QNetworkAccessManager* networkAccessManager() const;
 
     void track( const QList<QPair<QString, QString> >& parameters );
     void track( const QUrlQuery& data );
+    quint64 track( const ParameterList& parameters, const Completion& completion );
+    quint64 track( const QUrlQuery& data, const Completion& completion );
+    quint64 track( const ParameterList& parameters, const DeferredParameterList& deferred,
+                   const Completion& completion=Completion() );
+
+    void setParameterProvider( const QString& name, const ValueProvider& provider, int ttl=0 );
+    void removeParameterProvider( const QString& name );
 
     void setTrackingID( const QString& trackingID );
     QString trackingID() const;
@@ -65,6 +109,16 @@ public:
     void setEndpoint( const QUrl& endpoint );
     QUrl endpoint() const;
 
+    void setEndpoints( const QList<QUrl>& endpoints );
+    QList<QUrl> endpoints() const;
+    const EndpointPool& endpointPool() const;
+
+    void setEndpointCooldown( int msecs );
+    int endpointCooldown() const;
+
+    void setMaxRetries( int retries );
+    int maxRetries() const;
+
     void setClientID( const QString& clientID );
     QString clientID() const;
 
@@ -74,26 +128,128 @@ public:
     void setCacheBusting( bool enabled );
     bool cacheBusting() const;
 
+    void setBatching( bool enabled );
+    bool batching() const;
+
+    void setAdaptiveDispatch( bool enabled );
+    bool adaptiveDispatch() const;
+
+    void setTargetQueueDelay( int msecs );
+    int targetQueueDelay() const;
+
+    const DispatchController& dispatchController() const;
+    int pendingHits() const;
+
+    void setMaxPendingHits( int hits );
+    int maxPendingHits() const;
+
+    void setTraceRecorder( TraceRecorder* recorder );
+    TraceRecorder* traceRecorder() const;
+
+    void setReachability( Reachability* reachability );
+    Reachability* reachability() const;
+    bool isOnline() const;
+
+    bool startCapture( const QString& fileName );
+    void stopCapture();
+    bool isCapturing() const;
+
 signals:
     void tracked();
 
 private slots:
     void onFinished(QNetworkReply* reply);
+    void dispatch();
+    void onOnlineStateChanged( bool online );
+    void onReachabilityDestroyed();
 
 private:
+    // Hits and requests live in pooled slots that are recycled together with their buffers, so that tracking does
+    // not allocate once the pools have grown to the working set.
+    struct Hit
+    {
+        Hit() : id( 0 ), queuedAt( 0 ), retries( 0 ), resolved( false ), capture( false ), required( 0 ), failedAt( -1 ),
+              next( -1 ) {}
+
+        quint64 id;
+        QByteArray payload;
+        DeferredParameterList deferred;
+        qint64 queuedAt;
+        int retries;
+        bool resolved;
+        bool capture;
+        quint32 required; // parameters required by the hit type that are still missing until the hit is resolved
+        int failedAt;     // the endpoint the last attempt failed at, retries go elsewhere if possible
+        Completion completion;
+        int next;
+    };
+
+    struct Request
+    {
+        Request() : reply( nullptr ), endpoint( -1 ), sentAt( 0 ), bytes( 0 ), next( -1 ) {}
+
+        QNetworkReply* reply;
+        SlotQueue<Hit> hits;
+        int endpoint;
+        qint64 sentAt;
+        int bytes;
+        QByteArray body;
+        int next;
+    };
+
+    struct Provider
+    {
+        QString name;
+        QByteArray key;
+        ValueProvider provider;
+        int ttl;
+        qint64 evaluatedAt;
+        QString value;
+    };
+
     void connectSignals();
+    void abortRequests( bool requeue );
+    int acquireHit();
+    quint64 enqueue( int hit, const Completion& completion );
+    void scheduleDispatch();
+    void resolve( int hit );
+    int batchSize() const;
+    void complete( int hit, TrackResult::Status status, qint64 now );
+    void send( int endpoint, int maxHits );
+    void sendRequest( int slot, int endpoint, const SlotQueue<Hit>& batch, int bytes );
+    int findRequest( QNetworkReply* reply ) const;
+    const QNetworkRequest& postRequest( int endpoint, bool batch );
 
-    QNetworkAccessManager* m_nam;
+    QPointer<QNetworkAccessManager> m_nam;
     QString m_trackingID;
     QString m_userAgent;
-    QUrl m_endpoint;
+    EndpointPool m_endpoints;
     QString m_clientID;
     QNetworkAccessManager::Operation m_operation;
     bool m_cacheBusting;
-    QSet<QNetworkReply*> m_replies;
+    bool m_batching;
+    int m_maxRetries;
+    int m_maxPendingHits;
+    DispatchController m_dispatchController;
+    QElapsedTimer m_clock;
+    QTimer m_flushTimer;
+    quint64 m_nextHitID;
+    SlotPool<Hit> m_hits;
+    SlotQueue<Hit> m_queue;
+    SlotPool<Request> m_requests;
+    int m_inFlight;
+    QList<QNetworkRequest> m_postRequests;
+    TraceRecorder* m_trace;
+    QPointer<Reachability> m_reachability;
+    bool m_draining;
+    bool m_closing;
+    bool m_resolving;
+    CaptureWriter m_capture;
+    QList<Provider> m_providers;
 };
 
 QT_GA_EXPORTS bool isValidHit( const Tracker::ParameterList& parameters );
+QT_GA_EXPORTS bool isValidHit( const Tracker::ParameterList& parameters, const Tracker::DeferredParameterList& deferred );
 
 }
 
@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2014 Thomas Daehling <doc@methedrine.org>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "Reachability.h"
+
+#include <QtGlobal>
+#include <QNetworkConfigurationManager>
+
+using namespace QtGoogleAnalytics;
+
+Reachability::Reachability( QObject* parent )
+    : QObject( parent ), m_online( true )
+{
+}
+
+bool Reachability::isOnline() const
+{
+    return m_online;
+}
+
+void Reachability::setOnline( bool online )
+{
+    if ( online == m_online )
+    {
+        return;
+    }
+    m_online = online;
+    emit onlineStateChanged( online );
+}
+
+// QNetworkConfigurationManager is deprecated as of Qt 5.15, its replacement QNetworkInformation needs Qt 6.1
+#ifdef QT_WARNING_DISABLE_DEPRECATED
+QT_WARNING_PUSH
+QT_WARNING_DISABLE_DEPRECATED
+#endif
+
+NetworkReachability::NetworkReachability( QObject* parent )
+    : Reachability( parent ), m_manager( new QNetworkConfigurationManager( this ) )
+{
+    setOnline( m_manager->isOnline() );
+    connect( m_manager, SIGNAL( onlineStateChanged( bool ) ), this, SLOT( setOnline( bool ) ) );
+}
+
+#ifdef QT_WARNING_DISABLE_DEPRECATED
+QT_WARNING_POP
+#endif
@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2014 Thomas Daehling <doc@methedrine.org>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef REACHABILITY_H
+#define REACHABILITY_H
+
+#include "QtGoogleAnalytics_global.h"
+
+#include <QObject>
+
+class QNetworkConfigurationManager;
+
+namespace QtGoogleAnalytics
+{
+
+/*!
+ * \brief The Reachability tells a Tracker whether the network is available.
+ *
+ * The state is set through setOnline(), which makes this class usable as a manually controlled source, e.g. in tests or
+ * for applications that know better than the system. NetworkReachability follows the state reported by Qt.
+ *
+ * \sa Tracker::setReachability()
+ */
+class QT_GA_EXPORTS Reachability : public QObject
+{
+    Q_OBJECT
+public:
+    explicit Reachability( QObject* parent=nullptr );
+
+    bool isOnline() const;
+
+public slots:
+    void setOnline( bool online );
+
+signals:
+    void onlineStateChanged( bool online );
+
+private:
+    bool m_online;
+};
+
+/*!
+ * \brief The NetworkReachability follows the online state of the system as reported by QNetworkConfigurationManager.
+ */
+class QT_GA_EXPORTS NetworkReachability : public Reachability
+{
+    Q_OBJECT
+public:
+    explicit NetworkReachability( QObject* parent=nullptr );
+
+private:
+    QNetworkConfigurationManager* m_manager;
+};
+
+}
+
+#endif // REACHABILITY_H
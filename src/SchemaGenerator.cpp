@@ -0,0 +1,432 @@
+/*
+ * Copyright (c) 2014 Thomas Daehling <doc@methedrine.org>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+// Build time tool that turns MeasurementProtocol.schema into MeasurementProtocolSchema.h.
+// Usage: SchemaGenerator <schema file> <output header>
+
+#include "MeasurementProtocol.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace QtGoogleAnalytics;
+
+namespace
+{
+    struct ParameterEntry
+    {
+        std::string name;
+        std::string type;
+        int maxLength;
+        int maxIndex;
+        uint32_t requiredBit;
+        uint32_t hash;
+    };
+
+    struct HitTypeEntry
+    {
+        std::string name;
+        std::vector<std::string> required;
+    };
+
+    const uint32_t MaxDisplacement = 1u << 24;
+
+    uint32_t nextPowerOfTwo( size_t value )
+    {
+        uint32_t result = 1;
+        while ( result < value )
+        {
+            result <<= 1;
+        }
+        return result;
+    }
+
+    bool fail( int lineNumber, const std::string& message )
+    {
+        std::cerr << "schema:" << lineNumber << ": " << message << std::endl;
+        return false;
+    }
+
+    // parses a positive decimal number, rejecting anything that is not entirely digits or out of range
+    bool parsePositive( const std::string& word, int& value )
+    {
+        char* end = nullptr;
+        errno = 0;
+        const long number = std::strtol( word.c_str(), &end, 10 );
+        if ( word.empty() || *end != '\0' || errno == ERANGE || number <= 0 || number > INT_MAX )
+        {
+            return false;
+        }
+        value = static_cast<int>( number );
+        return true;
+    }
+
+    bool isValidName( const std::string& name )
+    {
+        if ( name.empty() || name[0] == Schema::IndexPlaceholder )
+        {
+            return false;
+        }
+        for ( size_t i = 0; i < name.size(); ++i )
+        {
+            const char c = name[i];
+            const bool isPlaceholder = ( c == Schema::IndexPlaceholder );
+            if ( ! ( ( c >= 'a' && c <= 'z' ) || isPlaceholder ) )
+            {
+                return false;
+            }
+            if ( isPlaceholder && i > 0 && name[i - 1] == Schema::IndexPlaceholder )
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool parse( std::istream& input, int& defaultMaxIndex,
+                std::vector<ParameterEntry>& parameters, std::vector<HitTypeEntry>& hitTypes )
+    {
+        std::string line;
+        int lineNumber = 0;
+        while ( std::getline( input, line ) )
+        {
+            ++lineNumber;
+            std::istringstream tokens( line );
+            std::vector<std::string> words;
+            std::string word;
+            while ( tokens >> word )
+            {
+                words.push_back( word );
+            }
+            if ( words.empty() || words[0][0] == '#' )
+            {
+                continue;
+            }
+
+            if ( words[0] == "index" && words.size() == 2 )
+            {
+                if ( ! parsePositive( words[1], defaultMaxIndex ) )
+                {
+                    return fail( lineNumber, "index must be a positive number, not '" + words[1] + "'" );
+                }
+            }
+            else if ( words[0] == "param" && words.size() >= 3 && words.size() <= 5 )
+            {
+                ParameterEntry entry;
+                entry.name = words[1];
+                entry.type = words[2];
+                entry.maxLength = 0;
+                entry.maxIndex = 0;
+                entry.requiredBit = 0;
+                entry.hash = Schema::HashBasis;
+
+                if ( ! isValidName( entry.name ) )
+                {
+                    return fail( lineNumber, "invalid parameter name '" + entry.name + "'" );
+                }
+                if ( entry.type != "text" && entry.type != "integer" && entry.type != "boolean" && entry.type != "currency" )
+                {
+                    return fail( lineNumber, "unknown type '" + entry.type + "'" );
+                }
+                if ( words.size() > 3 && words[3] != "-" && ! parsePositive( words[3], entry.maxLength ) )
+                {
+                    return fail( lineNumber, "length must be a positive number or '-', not '" + words[3] + "'" );
+                }
+
+                int indexCount = std::count( entry.name.begin(), entry.name.end(), Schema::IndexPlaceholder );
+                if ( indexCount > Schema::MaxIndexCount )
+                {
+                    return fail( lineNumber, "too many index placeholders in '" + entry.name + "'" );
+                }
+                if ( indexCount > 0 )
+                {
+                    entry.maxIndex = defaultMaxIndex;
+                    if ( words.size() > 4 && ! parsePositive( words[4], entry.maxIndex ) )
+                    {
+                        return fail( lineNumber, "index must be a positive number, not '" + words[4] + "'" );
+                    }
+                    if ( entry.maxIndex <= 0 )
+                    {
+                        return fail( lineNumber, "'" + entry.name + "' needs an index, but no default index is set" );
+                    }
+                }
+                else if ( words.size() > 4 )
+                {
+                    return fail( lineNumber, "'" + entry.name + "' has no index placeholder" );
+                }
+
+                for ( size_t i = 0; i < entry.name.size(); ++i )
+                {
+                    entry.hash = Schema::hashStep( entry.hash, entry.name[i] );
+                }
+                for ( size_t i = 0; i < parameters.size(); ++i )
+                {
+                    if ( parameters[i].name == entry.name )
+                    {
+                        return fail( lineNumber, "duplicate parameter '" + entry.name + "'" );
+                    }
+                    if ( parameters[i].hash == entry.hash )
+                    {
+                        return fail( lineNumber, "hash collision between '" + entry.name + "' and '" + parameters[i].name + "'" );
+                    }
+                }
+                parameters.push_back( entry );
+            }
+            else if ( words[0] == "hittype" && words.size() >= 2 )
+            {
+                HitTypeEntry entry;
+                entry.name = words[1];
+                entry.required.assign( words.begin() + 2, words.end() );
+                hitTypes.push_back( entry );
+            }
+            else
+            {
+                return fail( lineNumber, "cannot parse '" + line + "'" );
+            }
+        }
+
+        // isValidHit() identifies the hit type through this parameter
+        if ( std::none_of( parameters.begin(), parameters.end(), []( const ParameterEntry& p ) { return p.name == "t"; } ) )
+        {
+            return fail( lineNumber, "the hit type parameter 't' is missing" );
+        }
+        return true;
+    }
+
+    bool assignRequiredBits( std::vector<ParameterEntry>& parameters, const std::vector<HitTypeEntry>& hitTypes )
+    {
+        int nextBit = 0;
+        for ( size_t h = 0; h < hitTypes.size(); ++h )
+        {
+            for ( size_t r = 0; r < hitTypes[h].required.size(); ++r )
+            {
+                const std::string& name = hitTypes[h].required[r];
+                auto iter = std::find_if( parameters.begin(), parameters.end(),
+                                          [&name]( const ParameterEntry& p ) { return p.name == name; } );
+                if ( iter == parameters.end() )
+                {
+                    std::cerr << "hit type " << hitTypes[h].name << " requires unknown parameter " << name << std::endl;
+                    return false;
+                }
+                if ( iter->requiredBit == 0 )
+                {
+                    if ( nextBit == 32 )
+                    {
+                        std::cerr << "too many required parameters" << std::endl;
+                        return false;
+                    }
+                    iter->requiredBit = 1u << nextBit++;
+                }
+            }
+        }
+        return true;
+    }
+
+    // Hash and displace: keys are grouped into buckets by their hash, then the largest buckets are placed first by
+    // searching for a displacement that moves all of their keys into free slots.
+    bool buildPerfectHash( const std::vector<ParameterEntry>& parameters, uint32_t bucketCount, uint32_t slotCount,
+                           std::vector<uint32_t>& displacements, std::vector<int>& slots )
+    {
+        std::vector<std::vector<int> > buckets( bucketCount );
+        for ( size_t i = 0; i < parameters.size(); ++i )
+        {
+            buckets[Schema::hashBucket( parameters[i].hash, bucketCount - 1 )].push_back( static_cast<int>( i ) );
+        }
+
+        std::vector<uint32_t> order( bucketCount );
+        for ( uint32_t b = 0; b < bucketCount; ++b )
+        {
+            order[b] = b;
+        }
+        std::stable_sort( order.begin(), order.end(),
+                          [&buckets]( uint32_t lhs, uint32_t rhs ) { return buckets[lhs].size() > buckets[rhs].size(); } );
+
+        displacements.assign( bucketCount, 0 );
+        slots.assign( slotCount, -1 );
+        for ( size_t o = 0; o < order.size(); ++o )
+        {
+            const std::vector<int>& bucket = buckets[order[o]];
+            if ( bucket.empty() )
+            {
+                break;
+            }
+
+            bool placed = false;
+            for ( uint32_t displacement = 0; displacement < MaxDisplacement && ! placed; ++displacement )
+            {
+                std::vector<uint32_t> candidates;
+                placed = true;
+                for ( size_t k = 0; k < bucket.size() && placed; ++k )
+                {
+                    uint32_t slot = Schema::hashSlot( parameters[bucket[k]].hash, displacement, slotCount - 1 );
+                    placed = ( slots[slot] == -1 ) && std::find( candidates.begin(), candidates.end(), slot ) == candidates.end();
+                    candidates.push_back( slot );
+                }
+                if ( placed )
+                {
+                    displacements[order[o]] = displacement;
+                    for ( size_t k = 0; k < bucket.size(); ++k )
+                    {
+                        slots[candidates[k]] = bucket[k];
+                    }
+                }
+            }
+            if ( ! placed )
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    std::string valueType( const std::string& type )
+    {
+        if ( type == "integer" )
+        {
+            return "Integer";
+        }
+        if ( type == "boolean" )
+        {
+            return "Boolean";
+        }
+        if ( type == "currency" )
+        {
+            return "Currency";
+        }
+        return "Text";
+    }
+
+    void write( std::ostream& out, const std::vector<ParameterEntry>& parameters, const std::vector<HitTypeEntry>& hitTypes,
+                const std::vector<uint32_t>& displacements, const std::vector<int>& slots )
+    {
+        int hitTypeParameter = -1;
+        for ( size_t i = 0; i < parameters.size(); ++i )
+        {
+            if ( parameters[i].name == "t" )
+            {
+                hitTypeParameter = static_cast<int>( i );
+            }
+        }
+
+        out << "// Generated by SchemaGenerator from MeasurementProtocol.schema. Do not edit.\n\n";
+        out << "#ifndef MEASUREMENTPROTOCOLSCHEMA_H\n#define MEASUREMENTPROTOCOLSCHEMA_H\n\n";
+        out << "#include \"MeasurementProtocol.h\"\n\n";
+        out << "namespace QtGoogleAnalytics\n{\nnamespace Schema\n{\n";
+
+        out << "    constexpr Parameter Parameters[] =\n    {\n";
+        for ( size_t i = 0; i < parameters.size(); ++i )
+        {
+            const ParameterEntry& p = parameters[i];
+            out << "        { \"" << p.name << "\", " << valueType( p.type ) << ", " << p.maxLength << ", "
+                << p.maxIndex << ", 0x" << std::hex << p.requiredBit << std::dec << "u },\n";
+        }
+        out << "    };\n\n";
+        out << "    constexpr int ParameterCount = " << parameters.size() << ";\n";
+        out << "    constexpr int HitTypeParameter = " << hitTypeParameter << ";\n\n";
+
+        out << "    constexpr HitType HitTypes[] =\n    {\n";
+        for ( size_t h = 0; h < hitTypes.size(); ++h )
+        {
+            uint32_t required = 0;
+            for ( size_t r = 0; r < hitTypes[h].required.size(); ++r )
+            {
+                for ( size_t i = 0; i < parameters.size(); ++i )
+                {
+                    if ( parameters[i].name == hitTypes[h].required[r] )
+                    {
+                        required |= parameters[i].requiredBit;
+                    }
+                }
+            }
+            out << "        { \"" << hitTypes[h].name << "\", 0x" << std::hex << required << std::dec << "u },\n";
+        }
+        out << "    };\n\n";
+        out << "    constexpr int HitTypeCount = " << hitTypes.size() << ";\n\n";
+
+        out << "    constexpr uint32_t BucketMask = " << displacements.size() - 1 << "u;\n";
+        out << "    constexpr uint32_t Displacements[] =\n    {";
+        for ( size_t b = 0; b < displacements.size(); ++b )
+        {
+            out << ( b % 8 == 0 ? "\n        " : " " ) << displacements[b] << "u,";
+        }
+        out << "\n    };\n\n";
+
+        out << "    constexpr uint32_t SlotMask = " << slots.size() - 1 << "u;\n";
+        out << "    constexpr short Slots[] =\n    {";
+        for ( size_t s = 0; s < slots.size(); ++s )
+        {
+            out << ( s % 16 == 0 ? "\n        " : " " ) << slots[s] << ",";
+        }
+        out << "\n    };\n";
+
+        out << "}\n}\n\n#endif // MEASUREMENTPROTOCOLSCHEMA_H\n";
+    }
+}
+
+int main( int argc, char** argv )
+{
+    if ( argc != 3 )
+    {
+        std::cerr << "usage: " << argv[0] << " <schema file> <output header>" << std::endl;
+        return 1;
+    }
+
+    std::ifstream input( argv[1] );
+    if ( ! input )
+    {
+        std::cerr << "cannot open " << argv[1] << std::endl;
+        return 1;
+    }
+
+    int defaultMaxIndex = 0;
+    std::vector<ParameterEntry> parameters;
+    std::vector<HitTypeEntry> hitTypes;
+    if ( ! parse( input, defaultMaxIndex, parameters, hitTypes ) || ! assignRequiredBits( parameters, hitTypes ) )
+    {
+        return 1;
+    }
+
+    const uint32_t bucketCount = nextPowerOfTwo( ( parameters.size() + 1 ) / 2 );
+    const uint32_t slotCount = nextPowerOfTwo( parameters.size() * 2 );
+    std::vector<uint32_t> displacements;
+    std::vector<int> slots;
+    if ( ! buildPerfectHash( parameters, bucketCount, slotCount, displacements, slots ) )
+    {
+        std::cerr << "cannot find a perfect hash for " << parameters.size() << " parameters" << std::endl;
+        return 1;
+    }
+
+    std::ofstream output( argv[2] );
+    if ( ! output )
+    {
+        std::cerr << "cannot write " << argv[2] << std::endl;
+        return 1;
+    }
+    write( output, parameters, hitTypes, displacements, slots );
+    return output ? 0 : 1;
+}
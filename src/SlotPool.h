@@ -0,0 +1,191 @@
+/*
+ * Copyright (c) 2014 Thomas Daehling <doc@methedrine.org>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef SLOTPOOL_H
+#define SLOTPOOL_H
+
+#include <QVector>
+
+namespace QtGoogleAnalytics
+{
+
+/*!
+ * \brief The SlotPool hands out reusable slots of type T by index.
+ *
+ * Released slots are recycled in the order they were released, so a slot is reused as late as possible. The pool only
+ * grows when all slots are in use and never shrinks, so once it has grown to the working set no further allocations
+ * happen. T needs an int member called next, which the pool and SlotQueue use for linking slots.
+ *
+ * \note Growing the pool invalidates references to slots, indexes stay valid.
+ */
+template <typename T>
+class SlotPool
+{
+public:
+    SlotPool()
+        : m_freeHead( -1 ), m_freeTail( -1 )
+    {
+    }
+
+    int acquire()
+    {
+        if ( m_freeHead < 0 )
+        {
+            grow();
+        }
+        const int index = m_freeHead;
+        m_freeHead = m_slots[index].next;
+        if ( m_freeHead < 0 )
+        {
+            m_freeTail = -1;
+        }
+        m_slots[index].next = -1;
+        return index;
+    }
+
+    void release( int index )
+    {
+        m_slots[index].next = -1;
+        if ( m_freeTail >= 0 )
+        {
+            m_slots[m_freeTail].next = index;
+        }
+        else
+        {
+            m_freeHead = index;
+        }
+        m_freeTail = index;
+    }
+
+    T& operator[]( int index )
+    {
+        return m_slots[index];
+    }
+
+    const T& operator[]( int index ) const
+    {
+        return m_slots[index];
+    }
+
+    int capacity() const
+    {
+        return m_slots.size();
+    }
+
+private:
+    void grow()
+    {
+        const int first = m_slots.size();
+        m_slots.resize( qMax( 16, first * 2 ) );
+        for ( int i = first; i < m_slots.size(); ++i )
+        {
+            release( i );
+        }
+    }
+
+    QVector<T> m_slots;
+    int m_freeHead;
+    int m_freeTail;
+};
+
+/*!
+ * \brief The SlotQueue is a FIFO of slots of a SlotPool, linked through the slots themselves.
+ *
+ * A slot can only be in one queue at a time.
+ */
+template <typename T>
+class SlotQueue
+{
+public:
+    SlotQueue()
+        : m_head( -1 ), m_tail( -1 ), m_size( 0 )
+    {
+    }
+
+    bool isEmpty() const
+    {
+        return m_size == 0;
+    }
+
+    int size() const
+    {
+        return m_size;
+    }
+
+    int head() const
+    {
+        return m_head;
+    }
+
+    void enqueue( SlotPool<T>& pool, int index )
+    {
+        pool[index].next = -1;
+        if ( m_tail >= 0 )
+        {
+            pool[m_tail].next = index;
+        }
+        else
+        {
+            m_head = index;
+        }
+        m_tail = index;
+        m_size++;
+    }
+
+    int dequeue( SlotPool<T>& pool )
+    {
+        const int index = m_head;
+        m_head = pool[index].next;
+        if ( m_head < 0 )
+        {
+            m_tail = -1;
+        }
+        pool[index].next = -1;
+        m_size--;
+        return index;
+    }
+
+    // moves all slots of other in front of this queue, keeping their order
+    void prepend( SlotPool<T>& pool, SlotQueue& other )
+    {
+        if ( other.isEmpty() )
+        {
+            return;
+        }
+        pool[other.m_tail].next = m_head;
+        if ( m_tail < 0 )
+        {
+            m_tail = other.m_tail;
+        }
+        m_head = other.m_head;
+        m_size += other.m_size;
+        other = SlotQueue();
+    }
+
+private:
+    int m_head;
+    int m_tail;
+    int m_size;
+};
+
+}
+
+#endif // SLOTPOOL_H
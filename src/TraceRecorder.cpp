@@ -0,0 +1,166 @@
+/*
+ * Copyright (c) 2014 Thomas Daehling <doc@methedrine.org>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "TraceRecorder.h"
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QThread>
+
+using namespace QtGoogleAnalytics;
+
+const int TraceRecorder::DefaultCapacity( 64 * 1024 );
+
+TraceRecorder::TraceRecorder( int capacity )
+    : m_capacity( qMax( 1, capacity ) ), m_next( 0 )
+{
+    m_events.reset( new Event[m_capacity] );
+    m_clock.start();
+}
+
+int TraceRecorder::capacity() const
+{
+    return m_capacity;
+}
+
+/*!
+ * \brief TraceRecorder::size returns the number of events currently held in the ring buffer.
+ */
+int TraceRecorder::size() const
+{
+    const uint recorded = uint( m_next.load() );
+    return int( qMin( recorded, uint( m_capacity ) ) );
+}
+
+void TraceRecorder::clear()
+{
+    m_next.store( 0 );
+}
+
+/*!
+ * \brief TraceRecorder::now returns the current trace time in microseconds.
+ */
+qint64 TraceRecorder::now() const
+{
+    return m_clock.nsecsElapsed() / 1000;
+}
+
+/*!
+ * \brief TraceRecorder::complete records an event that started at \a start and ends now.
+ */
+void TraceRecorder::complete( const char* name, qint64 start, quint64 id )
+{
+    record( name, 'X', start, now() - start, id );
+}
+
+void TraceRecorder::instant( const char* name, quint64 id )
+{
+    record( name, 'i', now(), 0, id );
+}
+
+/*!
+ * \brief TraceRecorder::asyncBegin starts an event that may end in another call stack, e.g. the life time of a hit.
+ *
+ * \sa asyncEnd()
+ */
+void TraceRecorder::asyncBegin( const char* name, quint64 id )
+{
+    record( name, 'b', now(), 0, id );
+}
+
+void TraceRecorder::asyncEnd( const char* name, quint64 id )
+{
+    record( name, 'e', now(), 0, id );
+}
+
+void TraceRecorder::record( const char* name, char phase, qint64 timestamp, qint64 duration, quint64 id )
+{
+    const uint slot = uint( m_next.fetchAndAddRelaxed( 1 ) ) % uint( m_capacity );
+    Event& event = m_events[slot];
+    event.name = name;
+    event.phase = phase;
+    event.timestamp = timestamp;
+    event.duration = duration;
+    event.id = id;
+    event.thread = reinterpret_cast<quintptr>( QThread::currentThreadId() );
+}
+
+/*!
+ * \brief TraceRecorder::toChromeTrace returns the recorded events, oldest first, as Chrome trace event JSON.
+ */
+QByteArray TraceRecorder::toChromeTrace() const
+{
+    const uint recorded = uint( m_next.load() );
+    const int count = size();
+    const uint first = recorded > uint( m_capacity ) ? recorded % uint( m_capacity ) : 0;
+    const QByteArray pid = QByteArray::number( QCoreApplication::applicationPid() );
+
+    QByteArray json( "{\"traceEvents\":[" );
+    json.reserve( count * 128 );
+    for ( int i = 0; i < count; ++i )
+    {
+        const Event& event = m_events[( first + i ) % uint( m_capacity )];
+        if ( i > 0 )
+        {
+            json += ',';
+        }
+        json += "\n{\"name\":\"";
+        json += event.name;
+        json += "\",\"cat\":\"QtGoogleAnalytics\",\"ph\":\"";
+        json += event.phase;
+        json += "\",\"ts\":";
+        json += QByteArray::number( event.timestamp );
+        if ( event.phase == 'X' )
+        {
+            json += ",\"dur\":";
+            json += QByteArray::number( event.duration );
+        }
+        else if ( event.phase == 'i' )
+        {
+            json += ",\"s\":\"t\"";
+        }
+        if ( event.id != 0 )
+        {
+            json += ",\"id\":";
+            json += QByteArray::number( event.id );
+            json += ",\"args\":{\"hit\":";
+            json += QByteArray::number( event.id );
+            json += '}';
+        }
+        json += ",\"pid\":";
+        json += pid;
+        json += ",\"tid\":";
+        json += QByteArray::number( quint64( event.thread ) );
+        json += '}';
+    }
+    json += "\n]}\n";
+    return json;
+}
+
+bool TraceRecorder::save( const QString& fileName ) const
+{
+    QFile file( fileName );
+    if ( ! file.open( QIODevice::WriteOnly | QIODevice::Truncate ) )
+    {
+        qWarning( "Cannot write trace to %s: %s", qPrintable( fileName ), qPrintable( file.errorString() ) );
+        return false;
+    }
+    return file.write( toChromeTrace() ) >= 0;
+}
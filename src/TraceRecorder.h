@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2014 Thomas Daehling <doc@methedrine.org>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef TRACERECORDER_H
+#define TRACERECORDER_H
+
+#include "QtGoogleAnalytics_global.h"
+
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QScopedArrayPointer>
+#include <QString>
+
+namespace QtGoogleAnalytics
+{
+
+/*!
+ * \brief The TraceRecorder collects timing events of the tracker pipeline and exports them in the Chrome trace event
+ * format, which can be loaded into chrome://tracing.
+ *
+ * Events are written into a fixed size ring buffer, so the most recent capacity() events are kept. Recording only
+ * reserves a slot with an atomic increment and never allocates or locks. Event names must be string literals.
+ *
+ * \note Exporting while other threads still record may pick up partially written events.
+ */
+class QT_GA_EXPORTS TraceRecorder
+{
+public:
+    static const int DefaultCapacity;
+
+    explicit TraceRecorder( int capacity=DefaultCapacity );
+
+    int capacity() const;
+    int size() const;
+    void clear();
+
+    qint64 now() const;
+    void complete( const char* name, qint64 start, quint64 id=0 );
+    void instant( const char* name, quint64 id=0 );
+    void asyncBegin( const char* name, quint64 id );
+    void asyncEnd( const char* name, quint64 id );
+
+    QByteArray toChromeTrace() const;
+    bool save( const QString& fileName ) const;
+
+private:
+    Q_DISABLE_COPY( TraceRecorder )
+
+    struct Event
+    {
+        const char* name;
+        char phase;
+        qint64 timestamp;
+        qint64 duration;
+        quint64 id;
+        quintptr thread;
+    };
+
+    void record( const char* name, char phase, qint64 timestamp, qint64 duration, quint64 id );
+
+    QScopedArrayPointer<Event> m_events;
+    int m_capacity;
+    QAtomicInt m_next;
+    QElapsedTimer m_clock;
+};
+
+/*!
+ * \brief The TraceScope records the time spent in a scope as a complete event, if a recorder is given.
+ */
+class TraceScope
+{
+public:
+    TraceScope( TraceRecorder* recorder, const char* name, quint64 id=0 )
+        : m_recorder( recorder ), m_name( name ), m_id( id ), m_start( recorder ? recorder->now() : 0 )
+    {
+    }
+
+    ~TraceScope()
+    {
+        if ( m_recorder )
+        {
+            m_recorder->complete( m_name, m_start, m_id );
+        }
+    }
+
+private:
+    Q_DISABLE_COPY( TraceScope )
+
+    TraceRecorder* m_recorder;
+    const char* m_name;
+    quint64 m_id;
+    qint64 m_start;
+};
+
+}
+
+#endif // TRACERECORDER_H
@@ -26,9 +26,39 @@
 #include <QNetworkReply>
 #include <QNetworkRequest>
 
+namespace
+{
+    // a reply that succeeds on the next event loop iteration without touching the network
+    class LocalReply : public QNetworkReply
+    {
+    public:
+        LocalReply( QNetworkAccessManager::Operation op, const QNetworkRequest& request, QObject* parent )
+            : QNetworkReply( parent )
+        {
+            setOperation( op );
+            setRequest( request );
+            setUrl( request.url() );
+            setAttribute( QNetworkRequest::HttpStatusCodeAttribute, 200 );
+            open( QIODevice::ReadOnly );
+            setFinished( true );
+            QMetaObject::invokeMethod( this, "finished", Qt::QueuedConnection );
+        }
+
+        virtual void abort()
+        {
+        }
+
+    protected:
+        virtual qint64 readData( char*, qint64 )
+        {
+            return -1;
+        }
+    };
+}
+
 TestNetworkAccessManager::TestNetworkAccessManager(QObject *parent) :
     QNetworkAccessManager(parent), m_expectedRequest( nullptr ), m_failed( false ),
-    m_expectedOp( QNetworkAccessManager::PostOperation )
+    m_expectedOp( QNetworkAccessManager::PostOperation ), m_localReplies( false ), m_requestCount( 0 )
 {
 }
 
@@ -47,6 +77,11 @@ QNetworkReply* TestNetworkAccessManager::createRequest( QNetworkAccessManager::O
     // operation mismatch
     m_failed |= ( op != m_expectedOp );
 
+    m_requestCount++;
+    if ( m_localReplies )
+    {
+        return new LocalReply( op, request, this );
+    }
     return QNetworkAccessManager::createRequest( op, request, outgoingData );
 }
 
@@ -65,7 +100,20 @@ void TestNetworkAccessManager::setExpectedOperation( QNetworkAccessManager::Oper
     m_expectedOp = op;
 }
 
+/*!
+ * \brief TestNetworkAccessManager::setLocalReplies answers every request with a successful reply instead of sending it.
+ */
+void TestNetworkAccessManager::setLocalReplies( bool enabled )
+{
+    m_localReplies = enabled;
+}
+
 bool TestNetworkAccessManager::failed() const
 {
     return m_failed;
 }
+
+int TestNetworkAccessManager::requestCount() const
+{
+    return m_requestCount;
+}
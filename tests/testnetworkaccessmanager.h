@@ -38,8 +38,10 @@ public:
     void setExpectedRequest( QNetworkRequest *request );
     void setExpectedData( const QString& data );
     void setExpectedOperation( QNetworkAccessManager::Operation op );
+    void setLocalReplies( bool enabled );
 
     bool failed() const;
+    int requestCount() const;
 
 protected:
     virtual QNetworkReply* createRequest( Operation op, const QNetworkRequest &request, QIODevice *outgoingData = 0 );
@@ -49,6 +51,8 @@ private:
     bool m_failed;
     QString m_expectedData;
     QNetworkAccessManager::Operation m_expectedOp;
+    bool m_localReplies;
+    int m_requestCount;
 
 };
 
@@ -23,6 +23,8 @@
 #include <QNetworkRequest>
 #include <QSignalSpy>
 #include <QStringList>
+#include <QTemporaryFile>
+#include <QTest>
 #include <QTimer>
 #include <QUrl>
 #include <QUrlQuery>
@@ -30,12 +32,52 @@
 
 #include <gtest/gtest.h>
 
+#include <cstddef>
+
+#include "../src/DispatchController.h"
+#include "../src/EndpointPool.h"
+#include "../src/HitCapture.h"
+#include "../src/Reachability.h"
+#include "../src/SlotPool.h"
+#include "../src/TraceRecorder.h"
 #include "../src/QtGoogleAnalytics.h"
 
 #include "testnetworkaccessmanager.h"
 
 using namespace QtGoogleAnalytics;
 
+#ifdef __GLIBC__
+// Counts heap allocations of the test thread, including those made by Qt, while countAllocations is set. Other threads,
+// e.g. those Qt uses for requests of earlier tests, are not counted.
+extern "C" void* __libc_malloc( size_t size );
+extern "C" void* __libc_calloc( size_t count, size_t size );
+extern "C" void* __libc_realloc( void* ptr, size_t size );
+
+namespace
+{
+    thread_local bool countAllocations = false;
+    int allocations = 0;
+}
+
+extern "C" void* malloc( size_t size ) throw()
+{
+    allocations += countAllocations ? 1 : 0;
+    return __libc_malloc( size );
+}
+
+extern "C" void* calloc( size_t count, size_t size ) throw()
+{
+    allocations += countAllocations ? 1 : 0;
+    return __libc_calloc( count, size );
+}
+
+extern "C" void* realloc( void* ptr, size_t size ) throw()
+{
+    allocations += countAllocations ? 1 : 0;
+    return __libc_realloc( ptr, size );
+}
+#endif
+
 TEST(Validation, hitTypeTests)
 {
     Tracker::ParameterList params;
@@ -79,6 +121,8 @@ TEST(Validation, correctParameterTypeTests)
     // From that it follows that we only need to test Currency, Boolean and Integer values.
 
     baseParams << QPair<QString, QString>( "t", "event" );
+    baseParams << QPair<QString, QString>( "ec", "category" );
+    baseParams << QPair<QString, QString>( "ea", "action" );
 
     // 1. Boolean, valid
     params = baseParams;
@@ -112,6 +156,55 @@ TEST(Validation, correctParameterTypeTests)
     EXPECT_FALSE( isValidHit( params ) );
 }
 
+TEST(Validation, schemaTests)
+{
+    Tracker::ParameterList params, baseParams;
+    baseParams << QPair<QString, QString>( "t", "pageview" );
+
+    // 1. unknown parameters are rejected
+    params = baseParams;
+    params << QPair<QString, QString>( "foo", "bar" );
+    EXPECT_FALSE( isValidHit( params ) );
+    // 2. 'cm' is the campaign medium, 'cm<N>' a custom metric
+    params = baseParams;
+    params << QPair<QString, QString>( "cm", "email" );
+    params << QPair<QString, QString>( "cm1", "42" );
+    EXPECT_TRUE( isValidHit( params ) );
+    params = baseParams;
+    params << QPair<QString, QString>( "cm1", "email" );
+    EXPECT_FALSE( isValidHit( params ) );
+    // 3. indexes must be within range
+    params = baseParams;
+    params << QPair<QString, QString>( "cd200", "foo" );
+    EXPECT_TRUE( isValidHit( params ) );
+    params = baseParams;
+    params << QPair<QString, QString>( "cd201", "foo" );
+    EXPECT_FALSE( isValidHit( params ) );
+    params = baseParams;
+    params << QPair<QString, QString>( "cd0", "foo" );
+    EXPECT_FALSE( isValidHit( params ) );
+    params = baseParams;
+    params << QPair<QString, QString>( "cg6", "foo" );
+    EXPECT_FALSE( isValidHit( params ) );
+    // 4. nested indexes
+    params = baseParams;
+    params << QPair<QString, QString>( "il1pi2cd3", "foo" );
+    params << QPair<QString, QString>( "il1pi2cm3", "3" );
+    params << QPair<QString, QString>( "il1pi2pr", "1.00" );
+    EXPECT_TRUE( isValidHit( params ) );
+    params = baseParams;
+    params << QPair<QString, QString>( "il1pi2pr", "foo" );
+    EXPECT_FALSE( isValidHit( params ) );
+    // 5. required parameters of the remaining hit types
+    params.clear();
+    params << QPair<QString, QString>( "t", "timing" );
+    params << QPair<QString, QString>( "utc", "category" );
+    params << QPair<QString, QString>( "utv", "variable" );
+    EXPECT_FALSE( isValidHit( params ) );
+    params << QPair<QString, QString>( "utt", "120" );
+    EXPECT_TRUE( isValidHit( params ) );
+}
+
 TEST(Tracker, setNetworkAccessManager)
 {
     // Tests that we can a network manager to use
@@ -125,6 +218,44 @@ TEST(Tracker, setNetworkAccessManager)
     EXPECT_EQ( &nam, tracker.networkAccessManager() );
 }
 
+TEST(Tracker, destruction)
+{
+    Reachability reachability;
+    TestNetworkAccessManager nam;
+    QNetworkRequest expectedRequest;
+    Tracker::ParameterList params;
+    QList<TrackResult> results;
+    auto completion = [&results]( const TrackResult& result ) { results << result; };
+
+    params << qMakePair( QString( "t" ), QString( "pageview" ) );
+    expectedRequest.setHeader( QNetworkRequest::UserAgentHeader, Tracker::UserAgent );
+    expectedRequest.setHeader( QNetworkRequest::ContentTypeHeader, "application/x-www-form-urlencoded" );
+    expectedRequest.setUrl( QUrl( "unknown://localhost/collect" ) );
+    nam.setExpectedRequest( &expectedRequest );
+    nam.setExpectedData( "t=pageview&v=1&tid=UA-0-0&cid=QtGoogleAnalytics" );
+    {
+        Tracker tracker;
+        tracker.setTrackingID( "UA-0-0" );
+        tracker.setEndpoint( QUrl( "unknown://localhost/collect" ) );
+
+        // 1. requests in flight are sent again when the network access manager is replaced
+        tracker.track( params, completion );
+        tracker.setNetworkAccessManager( &nam );
+        EXPECT_EQ( 0, tracker.pendingHits() );
+        EXPECT_FALSE( nam.failed() );
+        EXPECT_TRUE( results.isEmpty() );
+
+        tracker.setReachability( &reachability );
+        reachability.setOnline( false );
+        tracker.track( params, completion );
+        EXPECT_EQ( 1, tracker.pendingHits() );
+    }
+    // 2. hits in flight and queued hits are failed when the tracker is destroyed
+    ASSERT_EQ( 2, results.size() );
+    EXPECT_EQ( TrackResult::Failed, results.at( 0 ).status );
+    EXPECT_EQ( TrackResult::Failed, results.at( 1 ).status );
+}
+
 TEST(Tracker, trackingID)
 {
     Tracker tracker;
@@ -213,6 +344,541 @@ TEST(Tracker, track)
     EXPECT_FALSE( nam.failed() );
 }
 
+TEST(Tracker, completion)
+{
+    TestNetworkAccessManager nam;
+    QNetworkRequest expectedRequest;
+    QList<TrackResult> results;
+    auto completion = [&results]( const TrackResult& result ) { results << result; };
+    Tracker tracker;
+    Tracker::ParameterList params;
+    QSignalSpy spy( &tracker, SIGNAL( tracked() ) );
+
+    // 1. invalid hits are rejected right away
+    EXPECT_EQ( 0u, tracker.track( params, completion ) );
+    ASSERT_EQ( 1, results.size() );
+    EXPECT_EQ( TrackResult::Rejected, results.at( 0 ).status );
+    EXPECT_EQ( 0, spy.count() );
+
+    // 2. valid hits report their outcome once they are done, failed hits after all retries
+    params << QPair<QString, QString>( "t", "pageview" );
+    EXPECT_EQ( 0, tracker.maxRetries() );
+    tracker.setMaxRetries( 2 );
+    tracker.setEndpointCooldown( 50 );
+    tracker.setEndpoint( QUrl( "unknown://localhost/collect" ) );
+    quint64 id = tracker.track( params, completion );
+    EXPECT_NE( 0u, id );
+    ASSERT_TRUE( spy.wait() );
+    QTest::qWait( 100 );
+    ASSERT_EQ( 2, results.size() );
+    EXPECT_EQ( 1, spy.count() );
+    EXPECT_EQ( id, results.at( 1 ).id );
+    EXPECT_EQ( TrackResult::Failed, results.at( 1 ).status );
+    EXPECT_EQ( 2, results.at( 1 ).retries );
+    EXPECT_LE( 0, results.at( 1 ).latency );
+
+    // 3. hits that were sent report success
+    expectedRequest.setHeader( QNetworkRequest::UserAgentHeader, Tracker::UserAgent );
+    expectedRequest.setHeader( QNetworkRequest::ContentTypeHeader, "application/x-www-form-urlencoded" );
+    expectedRequest.setUrl( Tracker::NormalEndpoint );
+    nam.setExpectedRequest( &expectedRequest );
+    nam.setExpectedData( "t=pageview&v=1&tid=UA-0-0&cid=QtGoogleAnalytics" );
+    nam.setLocalReplies( true );
+    tracker.setNetworkAccessManager( &nam );
+    tracker.setEndpoint( Tracker::NormalEndpoint );
+    tracker.setTrackingID( "UA-0-0" );
+    id = tracker.track( params, completion );
+    ASSERT_TRUE( spy.wait() );
+    EXPECT_FALSE( nam.failed() );
+    ASSERT_EQ( 3, results.size() );
+    EXPECT_EQ( 2, spy.count() );
+    EXPECT_EQ( id, results.at( 2 ).id );
+    EXPECT_EQ( TrackResult::Sent, results.at( 2 ).status );
+    EXPECT_EQ( 0, results.at( 2 ).retries );
+}
+
+TEST(Tracker, deferredParameters)
+{
+    TestNetworkAccessManager nam;
+    QNetworkRequest expectedRequest;
+    QList<TrackResult> results;
+    auto completion = [&results]( const TrackResult& result ) { results << result; };
+    Tracker tracker;
+    Tracker::ParameterList params;
+    Tracker::DeferredParameterList deferred;
+    int resolutions = 0;
+    int languages = 0;
+    const QString common( "v=1&tid=UA-0-0&cid=QtGoogleAnalytics" );
+
+    expectedRequest.setHeader( QNetworkRequest::UserAgentHeader, Tracker::UserAgent );
+    expectedRequest.setHeader( QNetworkRequest::ContentTypeHeader, "application/x-www-form-urlencoded" );
+    expectedRequest.setUrl( Tracker::NormalEndpoint );
+    nam.setExpectedRequest( &expectedRequest );
+    tracker.setNetworkAccessManager( &nam );
+    tracker.setTrackingID( "UA-0-0" );
+
+    // 1. providers of rejected hits are never called
+    deferred << qMakePair( QString( "sr" ), Tracker::ValueProvider( [&resolutions]() { ++resolutions; return QString( "1920x1080" ); } ) );
+    EXPECT_EQ( 0u, tracker.track( params, deferred ) );
+    params << qMakePair( QString( "t" ), QString( "event" ) ) << qMakePair( QString( "ec" ), QString( "category" ) );
+    EXPECT_EQ( 0u, tracker.track( params, deferred ) );
+    EXPECT_EQ( 0, resolutions );
+    // 2. deferred parameters count as present and are resolved when the hit is sent
+    deferred << qMakePair( QString( "ea" ), Tracker::ValueProvider( []() { return QString( "action" ); } ) );
+    nam.setExpectedData( "t=event&ec=category&" + common + "&sr=1920x1080&ea=action" );
+    EXPECT_NE( 0u, tracker.track( params, deferred ) );
+    EXPECT_EQ( 1, resolutions );
+    EXPECT_FALSE( nam.failed() );
+    // 3. the hit type cannot be deferred, values of the wrong type are dropped
+    params.clear();
+    deferred.clear();
+    deferred << qMakePair( QString( "t" ), Tracker::ValueProvider( []() { return QString( "pageview" ); } ) );
+    EXPECT_EQ( 0u, tracker.track( params, deferred ) );
+    params << qMakePair( QString( "t" ), QString( "pageview" ) );
+    deferred.clear();
+    deferred << qMakePair( QString( "je" ), Tracker::ValueProvider( []() { return QString( "yes" ); } ) );
+    nam.setExpectedData( "t=pageview&" + common );
+    tracker.track( params, deferred );
+    EXPECT_FALSE( nam.failed() );
+    // 4. tracker providers are cached for their ttl and do not override parameters of the hit
+    tracker.setParameterProvider( "ul", [&languages]() { ++languages; return QString( "en-us" ); }, 60000 );
+    nam.setExpectedData( "t=pageview&" + common + "&ul=en-us" );
+    tracker.track( params );
+    tracker.track( params );
+    EXPECT_EQ( 1, languages );
+    EXPECT_FALSE( nam.failed() );
+    params << qMakePair( QString( "ul" ), QString( "de-de" ) );
+    nam.setExpectedData( "t=pageview&ul=de-de&" + common );
+    tracker.track( params );
+    EXPECT_FALSE( nam.failed() );
+    // 5. removed providers are not called anymore
+    tracker.removeParameterProvider( "ul" );
+    params.removeLast();
+    nam.setExpectedData( "t=pageview&" + common );
+    tracker.track( params );
+    EXPECT_EQ( 1, languages );
+    EXPECT_FALSE( nam.failed() );
+    // 6. providers may track hits, which are sent after the hit that is being resolved
+    quint64 inner = 0;
+    deferred.clear();
+    deferred << qMakePair( QString( "ul" ), Tracker::ValueProvider( [&]() {
+        if ( inner == 0 )
+        {
+            // grows the hit pool while the outer hit is being resolved
+            for ( int i = 0; i < 32; ++i )
+            {
+                inner = tracker.track( params, deferred );
+            }
+        }
+        return QString( "en-us" );
+    } ) );
+    nam.setExpectedData( "t=pageview&" + common + "&ul=en-us" );
+    const quint64 outer = tracker.track( params, deferred );
+    EXPECT_EQ( outer + 32, inner );
+    EXPECT_EQ( 0, tracker.pendingHits() );
+    EXPECT_FALSE( nam.failed() );
+    // 7. deferred parameters do not override parameters of the hit
+    resolutions = 0;
+    params << qMakePair( QString( "ul" ), QString( "de-de" ) );
+    deferred.clear();
+    deferred << qMakePair( QString( "ul" ), Tracker::ValueProvider( [&resolutions]() { ++resolutions; return QString( "en-us" ); } ) );
+    nam.setExpectedData( "t=pageview&ul=de-de&" + common );
+    tracker.track( params, deferred );
+    EXPECT_EQ( 0, resolutions );
+    EXPECT_FALSE( nam.failed() );
+    // 8. hits whose required deferred parameter has no valid value are rejected
+    params.clear();
+    params << qMakePair( QString( "t" ), QString( "event" ) ) << qMakePair( QString( "ec" ), QString( "category" ) );
+    deferred.clear();
+    deferred << qMakePair( QString( "ea" ), Tracker::ValueProvider( []() { return QString(); } ) );
+    nam.setExpectedData( "" );
+    const quint64 rejected = tracker.track( params, deferred, completion );
+    EXPECT_NE( 0u, rejected );
+    ASSERT_EQ( 1, results.size() );
+    EXPECT_EQ( rejected, results.at( 0 ).id );
+    EXPECT_EQ( TrackResult::Rejected, results.at( 0 ).status );
+    EXPECT_EQ( 0, tracker.pendingHits() );
+    EXPECT_FALSE( nam.failed() );
+}
+
+TEST(Tracker, recycledHits)
+{
+    int resolutions = 0;
+    QList<TrackResult> results;
+    auto completion = [&results]( const TrackResult& result ) { results << result; };
+    Tracker tracker;
+    Tracker::ParameterList params;
+    Tracker::DeferredParameterList deferred;
+    Reachability reachability;
+    QUrlQuery query;
+
+    params << qMakePair( QString( "t" ), QString( "event" ) ) << qMakePair( QString( "ec" ), QString( "category" ) );
+    deferred << qMakePair( QString( "ea" ), Tracker::ValueProvider( [&resolutions]() { ++resolutions; return QString( "action" ); } ) );
+    query.addQueryItem( "t", "pageview" );
+    tracker.setEndpoint( QUrl( "unknown://localhost/collect" ) );
+    tracker.setReachability( &reachability );
+    reachability.setOnline( false );
+
+    // 1. a deferred hit pushed out of the queue is failed without being resolved
+    tracker.setMaxPendingHits( 1 );
+    const quint64 id = tracker.track( params, deferred, completion );
+    tracker.track( query, completion );
+    ASSERT_EQ( 1, results.size() );
+    EXPECT_EQ( id, results.at( 0 ).id );
+    EXPECT_EQ( TrackResult::Failed, results.at( 0 ).status );
+    // 2. hits reusing its slot do not call its providers
+    tracker.setMaxPendingHits( Tracker::DefaultMaxPendingHits );
+    for ( int i = 0; i < 32; ++i )
+    {
+        tracker.track( query, completion );
+    }
+    reachability.setOnline( true );
+    EXPECT_EQ( 0, tracker.pendingHits() );
+    EXPECT_EQ( 0, resolutions );
+    tracker.setReachability( nullptr );
+}
+
+TEST(Tracker, reachability)
+{
+    TestNetworkAccessManager nam;
+    QNetworkRequest expectedRequest;
+    QList<TrackResult> results;
+    auto completion = [&results]( const TrackResult& result ) { results << result; };
+    Tracker tracker;
+    Tracker::ParameterList params;
+    Reachability reachability;
+    QSignalSpy spy( &reachability, SIGNAL( onlineStateChanged( bool ) ) );
+    const QString hit( "t=pageview&v=1&tid=UA-0-0&cid=QtGoogleAnalytics" );
+
+    params << qMakePair( QString( "t" ), QString( "pageview" ) );
+    tracker.setNetworkAccessManager( &nam );
+    tracker.setTrackingID( "UA-0-0" );
+
+    // 1. Initialization
+    EXPECT_EQ( nullptr, tracker.reachability() );
+    EXPECT_TRUE( tracker.isOnline() );
+    EXPECT_TRUE( reachability.isOnline() );
+    reachability.setOnline( true );
+    EXPECT_EQ( 0, spy.count() );
+    // 2. hits are held back while offline
+    tracker.setReachability( &reachability );
+    EXPECT_EQ( &reachability, tracker.reachability() );
+    reachability.setOnline( false );
+    EXPECT_EQ( 1, spy.count() );
+    EXPECT_FALSE( tracker.isOnline() );
+    tracker.track( params );
+    tracker.track( params );
+    tracker.track( params );
+    EXPECT_EQ( 3, tracker.pendingHits() );
+    // 3. and drained in a batch once the network is back
+    expectedRequest.setHeader( QNetworkRequest::UserAgentHeader, Tracker::UserAgent );
+    expectedRequest.setHeader( QNetworkRequest::ContentTypeHeader, "application/x-www-form-urlencoded" );
+    expectedRequest.setUrl( Tracker::NormalEndpoint.resolved( QUrl( "batch" ) ) );
+    nam.setExpectedRequest( &expectedRequest );
+    nam.setExpectedData( hit + "\n" + hit + "\n" + hit );
+    reachability.setOnline( true );
+    EXPECT_TRUE( tracker.isOnline() );
+    EXPECT_EQ( 0, tracker.pendingHits() );
+    EXPECT_FALSE( nam.failed() );
+    // 4. the oldest hits are failed once too many are held back
+    EXPECT_EQ( Tracker::DefaultMaxPendingHits, tracker.maxPendingHits() );
+    tracker.setMaxPendingHits( 2 );
+    reachability.setOnline( false );
+    const quint64 oldest = tracker.track( params, completion );
+    tracker.track( params, completion );
+    tracker.track( params, completion );
+    EXPECT_EQ( 2, tracker.pendingHits() );
+    ASSERT_EQ( 1, results.size() );
+    EXPECT_EQ( oldest, results.at( 0 ).id );
+    EXPECT_EQ( TrackResult::Failed, results.at( 0 ).status );
+    // 5. without a reachability the network is assumed to be online
+    expectedRequest.setUrl( Tracker::NormalEndpoint );
+    nam.setExpectedData( hit );
+    tracker.setReachability( nullptr );
+    EXPECT_TRUE( tracker.isOnline() );
+    EXPECT_EQ( 0, tracker.pendingHits() );
+    EXPECT_FALSE( nam.failed() );
+    // 6. and a reachability that is destroyed is no longer used, the hits it held back are sent
+    {
+        Reachability temporary;
+        temporary.setOnline( false );
+        tracker.setReachability( &temporary );
+        EXPECT_FALSE( tracker.isOnline() );
+        tracker.track( params );
+        EXPECT_EQ( 1, tracker.pendingHits() );
+    }
+    EXPECT_EQ( nullptr, tracker.reachability() );
+    EXPECT_TRUE( tracker.isOnline() );
+    EXPECT_EQ( 0, tracker.pendingHits() );
+    EXPECT_FALSE( nam.failed() );
+}
+
+TEST(Tracker, offlineProbe)
+{
+    Tracker tracker;
+    Tracker::ParameterList params;
+    Reachability reachability;
+    QSignalSpy replies( tracker.networkAccessManager(), SIGNAL( finished( QNetworkReply* ) ) );
+
+    // requests to an unknown scheme fail without touching the network
+    params << qMakePair( QString( "t" ), QString( "pageview" ) );
+    tracker.setEndpoint( QUrl( "unknown://localhost/collect" ) );
+    tracker.setEndpointCooldown( 50 );
+    tracker.setReachability( &reachability );
+
+    // 1. consecutive failures open the breaker
+    for ( int i = 0; i < EndpointPool::DefaultFailureThreshold; ++i )
+    {
+        tracker.track( params );
+        ASSERT_TRUE( replies.wait() );
+    }
+    EXPECT_EQ( EndpointPool::Open, tracker.endpointPool().state( 0, 0 ) );
+    // 2. the network goes away while the probe is in flight
+    QTest::qWait( 100 );
+    tracker.track( params );
+    EXPECT_EQ( 0, tracker.pendingHits() );
+    reachability.setOnline( false );
+    ASSERT_TRUE( replies.wait() );
+    EXPECT_EQ( 1, tracker.pendingHits() );
+    // 3. so the probe is sent again once the network is back
+    reachability.setOnline( true );
+    EXPECT_EQ( 0, tracker.pendingHits() );
+    tracker.setReachability( nullptr );
+}
+
+TEST(Tracker, failover)
+{
+    TestNetworkAccessManager nam;
+    QNetworkRequest expectedRequest;
+    Tracker tracker;
+    Tracker::ParameterList params;
+    QSignalSpy replies( &nam, SIGNAL( finished( QNetworkReply* ) ) );
+    const QUrl unreachable( "unknown://localhost/collect" );
+
+    // requests to an unknown scheme fail without touching the network, the other endpoint is checked
+    expectedRequest.setHeader( QNetworkRequest::UserAgentHeader, Tracker::UserAgent );
+    expectedRequest.setHeader( QNetworkRequest::ContentTypeHeader, "application/x-www-form-urlencoded" );
+    expectedRequest.setUrl( Tracker::NormalEndpoint );
+    nam.setExpectedRequest( &expectedRequest );
+    nam.setExpectedData( "t=pageview&v=1&tid=UA-0-0&cid=QtGoogleAnalytics" );
+    params << qMakePair( QString( "t" ), QString( "pageview" ) );
+    tracker.setNetworkAccessManager( &nam );
+    tracker.setTrackingID( "UA-0-0" );
+    tracker.setEndpoints( QList<QUrl>() << unreachable << Tracker::NormalEndpoint );
+    tracker.setEndpointCooldown( 1000 );
+    tracker.setMaxRetries( 1 );
+
+    // 1. hits go to the first endpoint, and are retried at the second one once they failed there
+    tracker.track( params );
+    EXPECT_TRUE( nam.failed() );
+    while ( tracker.endpointPool().health( 0 ) == 1.0 && replies.wait() )
+    {
+    }
+    EXPECT_GT( 1.0, tracker.endpointPool().health( 0 ) );
+    EXPECT_FALSE( nam.failed() );
+    // 2. once the breaker of the first endpoint is open
+    tracker.setMaxRetries( 0 );
+    for ( int i = 1; i < EndpointPool::DefaultFailureThreshold; ++i )
+    {
+        const qreal health = tracker.endpointPool().health( 0 );
+        tracker.track( params );
+        while ( tracker.endpointPool().health( 0 ) == health && replies.wait() )
+        {
+        }
+    }
+    EXPECT_EQ( EndpointPool::Open, tracker.endpointPool().state( 0, 0 ) );
+    // 3. new hits skip it
+    tracker.track( params );
+    EXPECT_FALSE( nam.failed() );
+    EXPECT_EQ( 0, tracker.pendingHits() );
+}
+
+TEST(Tracker, adaptiveDispatch)
+{
+    TestNetworkAccessManager nam;
+    QNetworkRequest expectedRequest;
+    Tracker tracker;
+    Tracker::ParameterList params;
+    QSignalSpy replies( &nam, SIGNAL( finished( QNetworkReply* ) ) );
+    const QString hit( "t=pageview&v=1&tid=UA-0-0&cid=QtGoogleAnalytics" );
+
+    expectedRequest.setHeader( QNetworkRequest::UserAgentHeader, Tracker::UserAgent );
+    expectedRequest.setHeader( QNetworkRequest::ContentTypeHeader, "application/x-www-form-urlencoded" );
+    expectedRequest.setUrl( Tracker::NormalEndpoint );
+    nam.setExpectedRequest( &expectedRequest );
+    nam.setExpectedData( hit );
+    nam.setLocalReplies( true );
+    params << qMakePair( QString( "t" ), QString( "pageview" ) );
+    tracker.setNetworkAccessManager( &nam );
+    tracker.setTrackingID( "UA-0-0" );
+
+    // 1. Initialization
+    EXPECT_TRUE( tracker.batching() );
+    tracker.setAdaptiveDispatch( true );
+    EXPECT_TRUE( tracker.adaptiveDispatch() );
+    EXPECT_EQ( 1, tracker.dispatchController().batchSize() );
+    EXPECT_EQ( 1, tracker.dispatchController().concurrency() );
+    // 2. hits wait while as many requests are in flight as allowed
+    tracker.track( params );
+    tracker.track( params );
+    EXPECT_EQ( 1, nam.requestCount() );
+    EXPECT_EQ( 1, tracker.pendingHits() );
+    EXPECT_FALSE( nam.failed() );
+    // 3. successful requests grow the batch, so the waiting hit is held for the flush interval
+    ASSERT_TRUE( replies.wait() );
+    EXPECT_EQ( 2, tracker.dispatchController().batchSize() );
+    EXPECT_EQ( 2, tracker.dispatchController().concurrency() );
+    EXPECT_LT( 0, tracker.dispatchController().flushInterval() );
+    EXPECT_EQ( 1, nam.requestCount() );
+    EXPECT_EQ( 1, tracker.pendingHits() );
+    // 4. and sent on its own once the flush interval has passed
+    ASSERT_TRUE( replies.wait() );
+    EXPECT_EQ( 2, nam.requestCount() );
+    EXPECT_EQ( 0, tracker.pendingHits() );
+    EXPECT_FALSE( nam.failed() );
+    // 5. full batches are sent right away to the batch URL
+    const int batchSize = tracker.dispatchController().batchSize();
+    ASSERT_LT( 1, batchSize );
+    QStringList batch;
+    for ( int i = 0; i < batchSize; ++i )
+    {
+        batch << hit;
+    }
+    expectedRequest.setUrl( Tracker::NormalEndpoint.resolved( QUrl( "batch" ) ) );
+    nam.setExpectedData( batch.join( "\n" ) );
+    for ( int i = 0; i < batchSize; ++i )
+    {
+        tracker.track( params );
+    }
+    EXPECT_EQ( 3, nam.requestCount() );
+    EXPECT_EQ( 0, tracker.pendingHits() );
+    EXPECT_FALSE( nam.failed() );
+    ASSERT_TRUE( replies.wait() );
+    // 6. without batching every hit is sent on its own
+    tracker.setBatching( false );
+    EXPECT_FALSE( tracker.batching() );
+    expectedRequest.setUrl( Tracker::NormalEndpoint );
+    nam.setExpectedData( hit );
+    tracker.track( params );
+    EXPECT_EQ( 4, nam.requestCount() );
+    EXPECT_EQ( 0, tracker.pendingHits() );
+    EXPECT_FALSE( nam.failed() );
+}
+
+TEST(Tracker, payloadLimits)
+{
+    TestNetworkAccessManager nam;
+    QNetworkRequest expectedRequest;
+    QList<TrackResult> results;
+    auto completion = [&results]( const TrackResult& result ) { results << result; };
+    Tracker tracker;
+    Tracker::ParameterList params;
+    Reachability reachability;
+    TraceRecorder recorder;
+    const QString common( "v=1&tid=UA-0-0&cid=QtGoogleAnalytics" );
+    const QString language = QString( "%C3%BC" ).repeated( 10 );
+
+    expectedRequest.setHeader( QNetworkRequest::UserAgentHeader, Tracker::UserAgent );
+    expectedRequest.setHeader( QNetworkRequest::ContentTypeHeader, "application/x-www-form-urlencoded" );
+    expectedRequest.setUrl( Tracker::NormalEndpoint );
+    nam.setExpectedRequest( &expectedRequest );
+    tracker.setNetworkAccessManager( &nam );
+    tracker.setTrackingID( "UA-0-0" );
+
+    // 1. text values are truncated to their maximum length in bytes, without splitting characters
+    params << qMakePair( QString( "t" ), QString( "pageview" ) ) << qMakePair( QString( "ul" ), QString( "abcdefghijklmnopqrstuvwxyz" ) );
+    nam.setExpectedData( "t=pageview&ul=abcdefghijklmnopqrst&" + common );
+    tracker.track( params );
+    EXPECT_FALSE( nam.failed() );
+    params.last().second = QString( 11, QChar( 0xfc ) );
+    nam.setExpectedData( "t=pageview&ul=" + language + "&" + common );
+    tracker.track( params );
+    EXPECT_FALSE( nam.failed() );
+    // 2. hits that do not fit into a request are rejected
+    params << qMakePair( QString( "dl" ), QString( 2048, ' ' ) ) << qMakePair( QString( "dr" ), QString( 2048, ' ' ) );
+    EXPECT_EQ( 0u, tracker.track( params, completion ) );
+    ASSERT_EQ( 1, results.size() );
+    EXPECT_EQ( TrackResult::Rejected, results.at( 0 ).status );
+    // 3. GET hits with URLs that are too long are sent with POST
+    params.removeLast();
+    tracker.setOperation( QNetworkAccessManager::GetOperation );
+    nam.setExpectedData( "t=pageview&ul=" + language + "&dl=" + QString( "%20" ).repeated( 2048 ) + "&" + common );
+    EXPECT_NE( 0u, tracker.track( params ) );
+    EXPECT_FALSE( nam.failed() );
+    // 4. batches end before the hit that would exceed the byte limit
+    tracker.setOperation( QNetworkAccessManager::PostOperation );
+    tracker.setTraceRecorder( &recorder );
+    tracker.setReachability( &reachability );
+    reachability.setOnline( false );
+    for ( int i = 0; i < 3; ++i )
+    {
+        tracker.track( params );
+    }
+    recorder.clear();
+    reachability.setOnline( true );
+    EXPECT_EQ( 0, tracker.pendingHits() );
+    EXPECT_EQ( 2, recorder.toChromeTrace().count( "\"name\":\"dispatch\"" ) );
+    // 5. and at the hit limit
+    params.removeLast();
+    reachability.setOnline( false );
+    for ( int i = 0; i < DispatchController::MaxBatchSize + 1; ++i )
+    {
+        tracker.track( params );
+    }
+    recorder.clear();
+    reachability.setOnline( true );
+    EXPECT_EQ( 0, tracker.pendingHits() );
+    EXPECT_EQ( 2, recorder.toChromeTrace().count( "\"name\":\"dispatch\"" ) );
+    tracker.setReachability( nullptr );
+}
+
+TEST(Tracker, allocations)
+{
+#ifdef __GLIBC__
+    int failed = 0;
+    const Tracker::Completion completion = [&failed]( const TrackResult& result ) { failed += result.status == TrackResult::Failed ? 1 : 0; };
+    Tracker tracker;
+    Tracker::ParameterList params;
+    Reachability reachability;
+
+    params << QPair<QString, QString>( "t", "event" );
+    params << QPair<QString, QString>( "ec", "category" );
+    params << QPair<QString, QString>( "ea", "action" );
+    params << QPair<QString, QString>( "el", QString::fromUtf8( "label \xc3\xbc\xe2\x82\xac" ) );
+    params << QPair<QString, QString>( "ev", "-42" );
+    params << QPair<QString, QString>( "tr", "$-55.00" );
+    params << QPair<QString, QString>( "aip", "1" );
+    for ( int i = 1; i <= 43; ++i )
+    {
+        params << QPair<QString, QString>( QString( "cd%1" ).arg( i ), QString( "dimension %1" ).arg( i ) );
+    }
+    tracker.setTrackingID( "UA-0-0" );
+    tracker.setReachability( &reachability );
+    tracker.setMaxPendingHits( 8 );
+    reachability.setOnline( false );
+
+    // 1. while offline the oldest hits are failed, so hit slots are recycled once the pool has grown
+    for ( int i = 0; i < 32; ++i )
+    {
+        tracker.track( params, completion );
+    }
+    EXPECT_EQ( 24, failed );
+    // 2. after which validating, encoding and queueing a 50 parameter hit does not allocate
+    countAllocations = true;
+    allocations = 0;
+    for ( int i = 0; i < 32; ++i )
+    {
+        tracker.track( params, completion );
+    }
+    countAllocations = false;
+
+    EXPECT_EQ( 0, allocations );
+    EXPECT_EQ( 56, failed );
+    EXPECT_EQ( 8, tracker.pendingHits() );
+    tracker.setReachability( nullptr );
+#endif
+}
+
 TEST(Tracker, userAgent)
 {
     QtGoogleAnalytics::Tracker tracker;
@@ -280,6 +946,398 @@ TEST(Tracker, cacheBusting)
     EXPECT_TRUE( tracker.cacheBusting() );
 }
 
+TEST(DispatchController, defaults)
+{
+    DispatchController controller;
+    // 1. without adaptive dispatch every hit is sent on its own, right away
+    EXPECT_FALSE( controller.isAdaptive() );
+    EXPECT_EQ( 1, controller.batchSize() );
+    EXPECT_EQ( 0, controller.flushInterval() );
+    // 2. ... and this does not change with feedback
+    controller.onCompleted( 100, 50, 0, 1, 100, false );
+    controller.onCompleted( 200, 50, 0, 1, 100, false );
+    EXPECT_EQ( 1, controller.batchSize() );
+    EXPECT_EQ( 0, controller.flushInterval() );
+    EXPECT_DOUBLE_EQ( 50.0, controller.smoothedRoundTripTime() );
+}
+
+TEST(DispatchController, adaptive)
+{
+    DispatchController controller;
+    controller.setAdaptive( true );
+    controller.setTargetQueueDelay( 1000 );
+    qint64 now = 0;
+
+    // 1. additive increase while the network keeps up
+    for ( int i = 0; i < 50; ++i )
+    {
+        controller.onCompleted( now += 100, 100, 0, controller.batchSize(), controller.batchSize() * 200, false );
+    }
+    EXPECT_EQ( DispatchController::MaxBatchSize, controller.batchSize() );
+    EXPECT_LT( 1, controller.concurrency() );
+    EXPECT_LT( 0, controller.flushInterval() );
+    EXPECT_GE( 1000 - 100, controller.flushInterval() );
+
+    // 2. batches are limited by the batch payload size
+    controller.reset();
+    for ( int i = 0; i < 50; ++i )
+    {
+        controller.onCompleted( now += 100, 100, 0, 1, 4096, false );
+    }
+    EXPECT_EQ( DispatchController::MaxBatchBytes / 4096, controller.batchSize() );
+
+    // 3. multiplicative decrease on errors
+    int batchSize = controller.batchSize();
+    int concurrency = controller.concurrency();
+    controller.onCompleted( now += 100, 100, 0, 1, 4096, true );
+    EXPECT_EQ( batchSize / 2, controller.batchSize() );
+    EXPECT_EQ( qMax( 1, concurrency / 2 ), controller.concurrency() );
+    EXPECT_LT( 0.0, controller.errorRate() );
+
+    // 4. ... and when the round-trip time goes up
+    batchSize = controller.batchSize();
+    controller.onCompleted( now += 1000, 1000, 0, 1, 4096, false );
+    EXPECT_EQ( qMax( 1, batchSize / 2 ), controller.batchSize() );
+
+    // 5. flush sooner when hits wait longer than the target
+    int flushInterval = controller.flushInterval();
+    controller.onCompleted( now += 100, 100, 2000, 1, 4096, false );
+    EXPECT_EQ( flushInterval / 2, controller.flushInterval() );
+}
+
+namespace
+{
+    struct TestSlot
+    {
+        TestSlot() : value( 0 ), next( -1 ) {}
+
+        int value;
+        int next;
+    };
+}
+
+TEST(SlotPool, slots)
+{
+    SlotPool<TestSlot> pool;
+    SlotQueue<TestSlot> queue;
+    SlotQueue<TestSlot> front;
+
+    // 1. Initialization
+    EXPECT_EQ( 0, pool.capacity() );
+    EXPECT_TRUE( queue.isEmpty() );
+    EXPECT_EQ( -1, queue.head() );
+    // 2. slots are handed out in order and the pool grows on demand
+    const int first = pool.acquire();
+    const int second = pool.acquire();
+    EXPECT_EQ( 0, first );
+    EXPECT_EQ( 1, second );
+    EXPECT_EQ( 16, pool.capacity() );
+    // 3. released slots are reused last, in the order they were released
+    pool.release( second );
+    pool.release( first );
+    for ( int i = 2; i < 16; ++i )
+    {
+        EXPECT_EQ( i, pool.acquire() );
+    }
+    EXPECT_EQ( second, pool.acquire() );
+    EXPECT_EQ( first, pool.acquire() );
+    EXPECT_EQ( 16, pool.capacity() );
+    EXPECT_EQ( 16, pool.acquire() );
+    EXPECT_EQ( 32, pool.capacity() );
+    // 4. queues are FIFOs
+    for ( int i = 0; i < 4; ++i )
+    {
+        pool[i].value = i;
+        queue.enqueue( pool, i );
+    }
+    EXPECT_EQ( 4, queue.size() );
+    EXPECT_EQ( 0, queue.head() );
+    EXPECT_EQ( 0, pool[queue.dequeue( pool )].value );
+    EXPECT_EQ( 1, pool[queue.dequeue( pool )].value );
+    EXPECT_EQ( 2, queue.size() );
+    // 5. prepending moves a queue in front of another, keeping its order
+    front.enqueue( pool, 1 );
+    front.enqueue( pool, 0 );
+    queue.prepend( pool, front );
+    EXPECT_TRUE( front.isEmpty() );
+    EXPECT_EQ( 4, queue.size() );
+    EXPECT_EQ( 1, queue.dequeue( pool ) );
+    EXPECT_EQ( 0, queue.dequeue( pool ) );
+    EXPECT_EQ( 2, queue.dequeue( pool ) );
+    EXPECT_EQ( 3, queue.dequeue( pool ) );
+    EXPECT_TRUE( queue.isEmpty() );
+    // 6. ... also to an empty queue
+    front.enqueue( pool, 5 );
+    queue.prepend( pool, front );
+    EXPECT_EQ( 5, queue.head() );
+    queue.enqueue( pool, 6 );
+    EXPECT_EQ( 5, queue.dequeue( pool ) );
+    EXPECT_EQ( 6, queue.dequeue( pool ) );
+    EXPECT_EQ( -1, queue.head() );
+}
+
+TEST(EndpointPool, endpoints)
+{
+    EndpointPool pool( Tracker::NormalEndpoint );
+    // 1. Initialization
+    EXPECT_EQ( 1, pool.size() );
+    EXPECT_EQ( Tracker::NormalEndpoint, pool.url( 0 ) );
+    // 2. Invalid endpoints are skipped
+    pool.setEndpoints( QList<QUrl>() << QUrl( "" ) << Tracker::SecureEndpoint );
+    EXPECT_EQ( 1, pool.size() );
+    EXPECT_EQ( Tracker::SecureEndpoint, pool.url( 0 ) );
+    // 3. ... and a list without any valid endpoint is ignored
+    pool.setEndpoints( QList<QUrl>() << QUrl( "" ) );
+    EXPECT_EQ( 1, pool.size() );
+}
+
+TEST(EndpointPool, circuitBreaker)
+{
+    EndpointPool pool;
+    pool.setEndpoints( QList<QUrl>() << Tracker::SecureEndpoint << Tracker::NormalEndpoint );
+    pool.setFailureThreshold( 2 );
+    pool.setCooldown( 1000 );
+
+    // 1. the first endpoint is preferred while it is healthy
+    EXPECT_EQ( 0, pool.select( 0 ) );
+    pool.onFailure( 0, 0 );
+    EXPECT_EQ( EndpointPool::Closed, pool.state( 0, 0 ) );
+    EXPECT_GT( 1.0, pool.health( 0 ) );
+
+    // 2. consecutive failures open the breaker and fail over to the next endpoint
+    pool.onFailure( 0, 0 );
+    EXPECT_EQ( EndpointPool::Open, pool.state( 0, 0 ) );
+    EXPECT_EQ( 1, pool.select( 0 ) );
+    EXPECT_EQ( 1000, pool.nextProbe() );
+
+    // 3. after the cooldown a single probe is sent to the failing endpoint
+    EXPECT_EQ( EndpointPool::HalfOpen, pool.state( 0, 1000 ) );
+    EXPECT_EQ( 0, pool.select( 1000 ) );
+    EXPECT_EQ( 1, pool.select( 1000 ) );
+
+    // 4. a failing probe doubles the cooldown
+    pool.onFailure( 0, 1000 );
+    EXPECT_EQ( EndpointPool::Open, pool.state( 0, 2000 ) );
+    EXPECT_EQ( 3000, pool.nextProbe() );
+
+    // 5. a successful probe closes the breaker again
+    EXPECT_EQ( 0, pool.select( 3000 ) );
+    pool.onSuccess( 0 );
+    EXPECT_EQ( EndpointPool::Closed, pool.state( 0, 3000 ) );
+    EXPECT_EQ( -1, pool.nextProbe() );
+
+    // 6. nothing is sent while all breakers are open
+    pool.setEndpoints( QList<QUrl>() << Tracker::SecureEndpoint );
+    pool.onFailure( 0, 0 );
+    pool.onFailure( 0, 0 );
+    EXPECT_EQ( -1, pool.select( 500 ) );
+}
+
+TEST(EndpointPool, intermittentFailures)
+{
+    EndpointPool pool;
+    pool.setEndpoints( QList<QUrl>() << Tracker::SecureEndpoint << Tracker::NormalEndpoint );
+    pool.setCooldown( 1000 );
+
+    // 1. failures that are never consecutive enough still open the breaker once the health is low
+    pool.onFailure( 0, 0 );
+    pool.onFailure( 0, 0 );
+    pool.onSuccess( 0 );
+    pool.onFailure( 0, 0 );
+    EXPECT_EQ( EndpointPool::Closed, pool.state( 0, 0 ) );
+    EXPECT_EQ( 0, pool.select( 0 ) );
+    pool.onFailure( 0, 0 );
+    EXPECT_GT( 0.5, pool.health( 0 ) );
+    EXPECT_EQ( EndpointPool::Open, pool.state( 0, 0 ) );
+    EXPECT_EQ( 1, pool.select( 0 ) );
+
+    // 2. so the preferred endpoint is probed and used again once it has recovered
+    EXPECT_EQ( 1000, pool.nextProbe() );
+    EXPECT_EQ( 0, pool.select( 1000 ) );
+    pool.onSuccess( 0 );
+    EXPECT_EQ( EndpointPool::Closed, pool.state( 0, 1000 ) );
+    EXPECT_EQ( 1.0, pool.health( 0 ) );
+    EXPECT_EQ( 0, pool.select( 1000 ) );
+
+    // 3. an endpoint to avoid is only chosen if no other endpoint is available
+    EXPECT_EQ( 1, pool.select( 1000, 0 ) );
+    for ( int i = 0; i < EndpointPool::DefaultFailureThreshold; ++i )
+    {
+        pool.onFailure( 1, 1000 );
+    }
+    EXPECT_EQ( 0, pool.select( 1000, 0 ) );
+}
+
+TEST(TraceRecorder, record)
+{
+    TraceRecorder recorder( 4 );
+
+    // 1. Initialization
+    EXPECT_EQ( 4, recorder.capacity() );
+    EXPECT_EQ( 0, recorder.size() );
+
+    // 2. events are exported in Chrome's trace event format
+    {
+        TraceScope scope( &recorder, "validate" );
+    }
+    recorder.asyncBegin( "hit", 7 );
+    EXPECT_EQ( 2, recorder.size() );
+    QByteArray json = recorder.toChromeTrace();
+    EXPECT_TRUE( json.startsWith( "{\"traceEvents\":[" ) );
+    EXPECT_TRUE( json.contains( "\"name\":\"validate\",\"cat\":\"QtGoogleAnalytics\",\"ph\":\"X\"" ) );
+    EXPECT_TRUE( json.contains( "\"ph\":\"b\"" ) );
+    EXPECT_TRUE( json.contains( "\"id\":7" ) );
+
+    // 3. the ring buffer keeps the most recent events
+    recorder.instant( "retry", 1 );
+    recorder.instant( "retry", 2 );
+    recorder.asyncEnd( "hit", 7 );
+    EXPECT_EQ( 4, recorder.size() );
+    json = recorder.toChromeTrace();
+    EXPECT_FALSE( json.contains( "validate" ) );
+    EXPECT_LT( json.indexOf( "\"ph\":\"b\"" ), json.indexOf( "\"ph\":\"e\"" ) );
+
+    // 4. a disabled scope does not record anything
+    recorder.clear();
+    {
+        TraceScope scope( nullptr, "validate" );
+    }
+    EXPECT_EQ( 0, recorder.size() );
+}
+
+TEST(Tracker, traceRecorder)
+{
+    Tracker tracker;
+    TraceRecorder recorder;
+    Tracker::ParameterList params;
+
+    // 1. Initialization
+    EXPECT_EQ( nullptr, tracker.traceRecorder() );
+    // 2. stages of a rejected hit are recorded
+    tracker.setTraceRecorder( &recorder );
+    EXPECT_EQ( &recorder, tracker.traceRecorder() );
+    tracker.track( params );
+    EXPECT_TRUE( recorder.toChromeTrace().contains( "\"name\":\"validate\"" ) );
+    EXPECT_FALSE( recorder.toChromeTrace().contains( "\"name\":\"encode\"" ) );
+}
+
+TEST(HitCapture, roundTrip)
+{
+    QTemporaryFile file;
+    ASSERT_TRUE( file.open() );
+    file.close();
+
+    CaptureWriter writer;
+    CaptureReader reader;
+    qint64 timestamp = -1;
+    QByteArray payload;
+
+    // 1. Initialization
+    EXPECT_FALSE( writer.isOpen() );
+    EXPECT_FALSE( writer.write( 0, "t=event" ) );
+    EXPECT_FALSE( reader.open( file.fileName() ) );
+    // 2. timestamps are stored relative to the first hit
+    ASSERT_TRUE( writer.open( file.fileName() ) );
+    EXPECT_TRUE( writer.write( 1000, "t=pageview&dp=%2F" ) );
+    EXPECT_TRUE( writer.write( 1250, QByteArray() ) );
+    EXPECT_TRUE( writer.write( 1000000, QByteArray( 300, 'x' ) ) );
+    writer.close();
+    ASSERT_TRUE( reader.open( file.fileName() ) );
+    EXPECT_TRUE( reader.next( timestamp, payload ) );
+    EXPECT_EQ( 0, timestamp );
+    EXPECT_EQ( QByteArray( "t=pageview&dp=%2F" ), payload );
+    EXPECT_TRUE( reader.next( timestamp, payload ) );
+    EXPECT_EQ( 250, timestamp );
+    EXPECT_TRUE( payload.isEmpty() );
+    EXPECT_TRUE( reader.next( timestamp, payload ) );
+    EXPECT_EQ( 999000, timestamp );
+    EXPECT_EQ( QByteArray( 300, 'x' ), payload );
+    EXPECT_FALSE( reader.next( timestamp, payload ) );
+    EXPECT_FALSE( reader.hasError() );
+    reader.close();
+    // 3. truncated captures are detected
+    ASSERT_TRUE( file.open() );
+    file.resize( file.size() - 1 );
+    file.close();
+    ASSERT_TRUE( reader.open( file.fileName() ) );
+    EXPECT_TRUE( reader.next( timestamp, payload ) );
+    EXPECT_TRUE( reader.next( timestamp, payload ) );
+    EXPECT_FALSE( reader.next( timestamp, payload ) );
+    EXPECT_TRUE( reader.hasError() );
+}
+
+TEST(Tracker, capture)
+{
+    QTemporaryFile file;
+    ASSERT_TRUE( file.open() );
+    file.close();
+
+    Reachability reachability;
+    Tracker tracker;
+    Tracker::ParameterList params;
+    CaptureReader reader;
+    qint64 timestamp = -1;
+    QByteArray payload;
+
+    // 1. Initialization
+    EXPECT_FALSE( tracker.isCapturing() );
+    // 2. only accepted hits are captured
+    ASSERT_TRUE( tracker.startCapture( file.fileName() ) );
+    EXPECT_TRUE( tracker.isCapturing() );
+    tracker.setTrackingID( "UA-123456-1" );
+    tracker.track( params );
+    params << qMakePair( QString( "t" ), QString( "pageview" ) );
+    tracker.track( params );
+    tracker.stopCapture();
+    EXPECT_FALSE( tracker.isCapturing() );
+    tracker.track( params );
+    ASSERT_TRUE( reader.open( file.fileName() ) );
+    EXPECT_TRUE( reader.next( timestamp, payload ) );
+    EXPECT_EQ( QByteArray( "t=pageview&v=1&tid=UA-123456-1&cid=QtGoogleAnalytics" ), payload );
+    EXPECT_FALSE( reader.next( timestamp, payload ) );
+    EXPECT_FALSE( reader.hasError() );
+    // 3. hits tracked before the capture are not captured when they are sent during it
+    tracker.setEndpoint( QUrl( "unknown://localhost/collect" ) );
+    tracker.setReachability( &reachability );
+    reachability.setOnline( false );
+    params << qMakePair( QString( "dp" ), QString( "/a" ) );
+    tracker.track( params );
+    ASSERT_TRUE( tracker.startCapture( file.fileName() ) );
+    params.last().second = "/b";
+    tracker.track( params );
+    reachability.setOnline( true );
+    EXPECT_EQ( 0, tracker.pendingHits() );
+    // 4. hits held back while offline are captured when the capture stops
+    reachability.setOnline( false );
+    params.last().second = "/c";
+    tracker.track( params );
+    tracker.stopCapture();
+    EXPECT_EQ( 1, tracker.pendingHits() );
+    ASSERT_TRUE( reader.open( file.fileName() ) );
+    EXPECT_TRUE( reader.next( timestamp, payload ) );
+    EXPECT_EQ( QByteArray( "t=pageview&dp=%2Fb&v=1&tid=UA-123456-1&cid=QtGoogleAnalytics" ), payload );
+    EXPECT_TRUE( reader.next( timestamp, payload ) );
+    EXPECT_EQ( QByteArray( "t=pageview&dp=%2Fc&v=1&tid=UA-123456-1&cid=QtGoogleAnalytics" ), payload );
+    EXPECT_FALSE( reader.next( timestamp, payload ) );
+    EXPECT_FALSE( reader.hasError() );
+    // 5. destroying a tracker stops its capture, including hits that are still held back
+    {
+        Tracker closing;
+        closing.setTrackingID( "UA-123456-1" );
+        closing.setReachability( &reachability );
+        ASSERT_TRUE( closing.startCapture( file.fileName() ) );
+        params.last().second = "/d";
+        closing.track( params );
+        EXPECT_EQ( 1, closing.pendingHits() );
+    }
+    ASSERT_TRUE( reader.open( file.fileName() ) );
+    EXPECT_TRUE( reader.next( timestamp, payload ) );
+    EXPECT_EQ( QByteArray( "t=pageview&dp=%2Fd&v=1&tid=UA-123456-1&cid=QtGoogleAnalytics" ), payload );
+    EXPECT_FALSE( reader.next( timestamp, payload ) );
+    EXPECT_FALSE( reader.hasError() );
+    tracker.setReachability( nullptr );
+}
+
 int main(int argc, char** argv)
 {
     QCoreApplication app( argc, argv );
@@ -0,0 +1,181 @@
+/*
+ * Copyright (c) 2014 Thomas Daehling <doc@methedrine.org>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "Replayer.h"
+
+#include <QUrlQuery>
+
+#include <algorithm>
+
+using namespace QtGoogleAnalytics;
+
+namespace
+{
+    // hits submitted per event loop iteration when replaying as fast as possible
+    const int MaxBurst = 1000;
+
+    qint64 percentile( const QVector<qint64>& sorted, int p )
+    {
+        if ( sorted.isEmpty() )
+        {
+            return 0;
+        }
+        const int rank = ( sorted.size() * p + 99 ) / 100;
+        return sorted.at( qMax( 1, rank ) - 1 );
+    }
+}
+
+Replayer::Replayer( Tracker* tracker, QObject* parent )
+    : QObject( parent ), m_tracker( tracker ), m_speed( 1.0 ), m_timer( this ), m_duration( 0 ), m_hasNext( false ),
+      m_nextTimestamp( 0 ), m_waiting( false ), m_submitted( 0 ), m_sent( 0 ), m_failed( 0 ), m_rejected( 0 )
+{
+    m_timer.setSingleShot( true );
+    connect( &m_timer, SIGNAL( timeout() ), this, SLOT( submit() ) );
+}
+
+bool Replayer::open( const QString& fileName )
+{
+    if ( ! m_reader.open( fileName ) )
+    {
+        return false;
+    }
+    m_hasNext = m_reader.next( m_nextTimestamp, m_nextPayload );
+    return ! m_reader.hasError();
+}
+
+/*!
+ * \brief Replayer::setSpeed scales the time between hits by 1 / \a speed. A speed of 0 replays as fast as possible.
+ */
+void Replayer::setSpeed( double speed )
+{
+    if ( speed < 0 )
+    {
+        return;
+    }
+    m_speed = speed;
+}
+
+double Replayer::speed() const
+{
+    return m_speed;
+}
+
+void Replayer::start()
+{
+    m_clock.start();
+    submit();
+}
+
+/*!
+ * \brief Replayer::submit tracks all hits that are due and schedules itself for the next one.
+ *
+ * When replaying as fast as possible it stops while the tracker holds as many hits as it allows, so that hits are not
+ * failed by Tracker::maxPendingHits(), and continues once hits complete.
+ */
+void Replayer::submit()
+{
+    const qint64 elapsed = m_clock.elapsed();
+    int burst = 0;
+    while ( m_hasNext && ( m_speed > 0 ? qint64( m_nextTimestamp / m_speed ) <= elapsed :
+                           burst < MaxBurst && m_tracker->pendingHits() < m_tracker->maxPendingHits() ) )
+    {
+        m_tracker->track( QUrlQuery( QString::fromLatin1( m_nextPayload ) ),
+                          [this]( const TrackResult& result ) { onCompleted( result ); } );
+        m_submitted++;
+        burst++;
+        m_hasNext = m_reader.next( m_nextTimestamp, m_nextPayload );
+    }
+
+    if ( m_reader.hasError() )
+    {
+        qWarning( "The capture is truncated, replaying the first %d hits only", m_submitted );
+    }
+
+    if ( m_hasNext && m_speed == 0 && m_tracker->pendingHits() >= m_tracker->maxPendingHits() )
+    {
+        m_waiting = true;
+    }
+    else if ( m_hasNext )
+    {
+        m_timer.start( m_speed > 0 ? int( qMax( Q_INT64_C( 0 ), qint64( m_nextTimestamp / m_speed ) - elapsed ) ) : 0 );
+    }
+    else if ( isFinished() )
+    {
+        m_duration = m_clock.elapsed();
+        emit finished();
+    }
+}
+
+void Replayer::onCompleted( const TrackResult& result )
+{
+    switch ( result.status )
+    {
+    case TrackResult::Sent:
+        m_sent++;
+        break;
+    case TrackResult::Failed:
+        m_failed++;
+        break;
+    case TrackResult::Rejected:
+        // rejected hits were never sent, so they have no latency
+        m_rejected++;
+        break;
+    }
+    if ( result.status != TrackResult::Rejected )
+    {
+        m_latencies.append( result.latency );
+    }
+
+    if ( m_waiting )
+    {
+        // the tracker is the caller, so submitting continues from the event loop
+        m_waiting = false;
+        m_timer.start( 0 );
+    }
+
+    if ( isFinished() )
+    {
+        m_duration = m_clock.elapsed();
+        emit finished();
+    }
+}
+
+bool Replayer::isFinished() const
+{
+    return ! m_hasNext && m_sent + m_failed + m_rejected == m_submitted;
+}
+
+/*!
+ * \brief Replayer::report writes the number of hits, the throughput and latency percentiles of the replay to \a out.
+ */
+void Replayer::report( QTextStream& out ) const
+{
+    QVector<qint64> sorted( m_latencies );
+    std::sort( sorted.begin(), sorted.end() );
+    const double seconds = qMax( Q_INT64_C( 1 ), m_duration ) / 1000.0;
+
+    out << "hits:       " << m_submitted << " (" << m_sent << " sent, " << m_failed << " failed, " << m_rejected
+        << " rejected)\n";
+    out << "duration:   " << m_duration << " ms\n";
+    out << "throughput: " << QString::number( m_submitted / seconds, 'f', 1 ) << " hits/s\n";
+    out << "latency:    p50 " << percentile( sorted, 50 ) << " ms, p90 " << percentile( sorted, 90 )
+        << " ms, p99 " << percentile( sorted, 99 ) << " ms, max " << ( sorted.isEmpty() ? 0 : sorted.last() )
+        << " ms\n";
+}
@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2014 Thomas Daehling <doc@methedrine.org>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef REPLAYER_H
+#define REPLAYER_H
+
+#include "../src/HitCapture.h"
+#include "../src/QtGoogleAnalytics.h"
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QObject>
+#include <QTextStream>
+#include <QTimer>
+#include <QVector>
+
+/*!
+ * \brief The Replayer feeds the hits of a capture file into a tracker, either with their original timing scaled by a
+ * speed factor or as fast as possible, and collects throughput and latency figures from the hit completions.
+ */
+class Replayer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit Replayer( QtGoogleAnalytics::Tracker* tracker, QObject* parent=nullptr );
+
+    bool open( const QString& fileName );
+
+    void setSpeed( double speed );
+    double speed() const;
+
+    void report( QTextStream& out ) const;
+
+public slots:
+    void start();
+
+signals:
+    void finished();
+
+private slots:
+    void submit();
+
+private:
+    void onCompleted( const QtGoogleAnalytics::TrackResult& result );
+    bool isFinished() const;
+
+    QtGoogleAnalytics::Tracker* m_tracker;
+    QtGoogleAnalytics::CaptureReader m_reader;
+    double m_speed;
+    QTimer m_timer;
+    QElapsedTimer m_clock;
+    qint64 m_duration;
+    bool m_hasNext;
+    qint64 m_nextTimestamp;
+    QByteArray m_nextPayload;
+    bool m_waiting;
+    int m_submitted;
+    int m_sent;
+    int m_failed;
+    int m_rejected;
+    QVector<qint64> m_latencies;
+};
+
+#endif // REPLAYER_H
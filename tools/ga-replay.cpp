@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2014 Thomas Daehling <doc@methedrine.org>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "Replayer.h"
+
+#include <QCoreApplication>
+#include <QStringList>
+#include <QTextStream>
+#include <QTimer>
+#include <QUrl>
+
+using namespace QtGoogleAnalytics;
+
+namespace
+{
+    int usage( const QString& error=QString() )
+    {
+        QTextStream err( stderr );
+        if ( ! error.isEmpty() )
+        {
+            err << error << "\n";
+        }
+        err << "Usage: ga-replay [options] <capture>\n"
+               "Replays a capture recorded with Tracker::startCapture() and reports throughput and latency.\n\n"
+               "  --speed <factor>   replay at factor times the recorded speed, or 'max' (default: 1)\n"
+               "  --endpoint <url>   send hits to url, may be given more than once (default: "
+            << Tracker::NormalEndpoint.toString() << ")\n"
+               "  --get              send hits with GET requests instead of POST\n"
+               "  --adaptive         adapt batching and concurrency to the observed round trip times\n"
+               "  --max-pending <n>  let the tracker hold up to n unsent hits before failing the oldest (default: "
+            << Tracker::DefaultMaxPendingHits << ")\n";
+        return 1;
+    }
+}
+
+int main( int argc, char** argv )
+{
+    QCoreApplication app( argc, argv );
+    QStringList arguments = app.arguments();
+    arguments.removeFirst();
+
+    double speed = 1.0;
+    QList<QUrl> endpoints;
+    bool get = false;
+    bool adaptive = false;
+    int maxPendingHits = Tracker::DefaultMaxPendingHits;
+    QString fileName;
+    while ( ! arguments.isEmpty() )
+    {
+        const QString argument = arguments.takeFirst();
+        if ( argument == "--speed" && ! arguments.isEmpty() )
+        {
+            const QString value = arguments.takeFirst();
+            bool ok = true;
+            speed = value == "max" ? 0 : value.toDouble( &ok );
+            if ( ! ok || speed < 0 || ( speed == 0 && value != "max" ) )
+            {
+                return usage( "Invalid speed: " + value );
+            }
+        }
+        else if ( argument == "--endpoint" && ! arguments.isEmpty() )
+        {
+            const QUrl url( arguments.takeFirst(), QUrl::StrictMode );
+            if ( ! url.isValid() || url.isRelative() )
+            {
+                return usage( "Invalid endpoint: " + url.toString() );
+            }
+            endpoints << url;
+        }
+        else if ( argument == "--get" )
+        {
+            get = true;
+        }
+        else if ( argument == "--adaptive" )
+        {
+            adaptive = true;
+        }
+        else if ( argument == "--max-pending" && ! arguments.isEmpty() )
+        {
+            const QString value = arguments.takeFirst();
+            bool ok = false;
+            maxPendingHits = value.toInt( &ok );
+            if ( ! ok || maxPendingHits <= 0 )
+            {
+                return usage( "Invalid number of pending hits: " + value );
+            }
+        }
+        else if ( ! argument.startsWith( "--" ) && fileName.isEmpty() )
+        {
+            fileName = argument;
+        }
+        else
+        {
+            return usage( "Unexpected argument: " + argument );
+        }
+    }
+    if ( fileName.isEmpty() )
+    {
+        return usage();
+    }
+
+    Tracker tracker;
+    if ( endpoints.size() == 1 )
+    {
+        tracker.setEndpoint( endpoints.first() );
+    }
+    else if ( endpoints.size() > 1 )
+    {
+        tracker.setEndpoints( endpoints );
+    }
+    tracker.setOperation( get ? QNetworkAccessManager::GetOperation : QNetworkAccessManager::PostOperation );
+    tracker.setAdaptiveDispatch( adaptive );
+    tracker.setMaxPendingHits( maxPendingHits );
+
+    Replayer replayer( &tracker );
+    replayer.setSpeed( speed );
+    if ( ! replayer.open( fileName ) )
+    {
+        return 1;
+    }
+    QObject::connect( &replayer, SIGNAL( finished() ), &app, SLOT( quit() ) );
+    QTimer::singleShot( 0, &replayer, SLOT( start() ) );
+    app.exec();
+
+    QTextStream out( stdout );
+    replayer.report( out );
+    return 0;
+}